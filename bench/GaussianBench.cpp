@@ -0,0 +1,154 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Throughput of the 'valid' Gaussian filtering used by SSIM, MS-SSIM and VIFp.
+
+ Usage:
+  gaussian_bench [Width Height [Iterations]]
+
+ For each window of the metrics, the following implementations are timed
+ on a random image (default: 1920x1080, 20 iterations):
+ - opencv: cv::GaussianBlur of the whole image followed by a copy of the
+   valid region (implementation used before GaussianFilter)
+ - float: GaussianFilter::apply on a CV_32F image
+ - float/8u: GaussianFilter::apply on a CV_8U image
+ - fixed/8u: GaussianFilter::applyFixed on a CV_8U image
+ The throughput is given in output megapixels per second, along with the
+ maximum absolute difference with the opencv implementation.
+ The instruction set of the kernels can be forced with VQMT_ISA.
+
+**************************************************************************/
+
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "GaussianFilter.hpp"
+#include "Kernels.hpp"
+
+enum Impl {
+	IMPL_OPENCV,
+	IMPL_FLOAT,
+	IMPL_FLOAT_8U,
+	IMPL_FIXED_8U,
+	IMPL_SIZE
+};
+
+static const char *IMPL_NAME[IMPL_SIZE] = {"opencv", "float", "float/8u", "fixed/8u"};
+
+static void filter(int impl, const cv::Mat& src32f, const cv::Mat& src8u, cv::Mat& dst, int ksize, double sigma)
+{
+	switch (impl) {
+		case IMPL_OPENCV: {
+			int invalid = (ksize-1)/2;
+			cv::Mat tmp(src32f.rows, src32f.cols, CV_32F);
+			cv::GaussianBlur(src32f, tmp, cv::Size(ksize,ksize), sigma);
+			tmp(cv::Range(invalid, tmp.rows-invalid), cv::Range(invalid, tmp.cols-invalid)).copyTo(dst);
+			break;
+		}
+		case IMPL_FLOAT:
+			GaussianFilter::get(ksize, sigma).apply(src32f, dst);
+			break;
+		case IMPL_FLOAT_8U:
+			GaussianFilter::get(ksize, sigma).apply(src8u, dst);
+			break;
+		case IMPL_FIXED_8U:
+			GaussianFilter::get(ksize, sigma).applyFixed(src8u, dst);
+			break;
+		default:
+			break;
+	}
+}
+
+static double maxAbsDiff(const cv::Mat& a, const cv::Mat& b)
+{
+	double d = 0.0;
+	for (int i=0; i<a.rows; i++) {
+		const float *pa = a.ptr<float>(i);
+		const float *pb = b.ptr<float>(i);
+		for (int j=0; j<a.cols; j++) {
+			double e = fabs(static_cast<double>(pa[j]) - static_cast<double>(pb[j]));
+			if (e > d) d = e;
+		}
+	}
+	return d;
+}
+
+int main(int argc, const char *argv[])
+{
+	int width = argc > 2 ? atoi(argv[1]) : 1920;
+	int height = argc > 2 ? atoi(argv[2]) : 1080;
+	int iterations = argc > 3 ? atoi(argv[3]) : 20;
+	if (width <= 17 || height <= 17 || iterations <= 0) {
+		fprintf(stderr, "Usage: gaussian_bench [Width Height [Iterations]]\n");
+		return EXIT_FAILURE;
+	}
+
+	Kernels::init(NULL);
+
+	// Random 8-bit image, smoothed a little so that it looks like video
+	cv::Mat src8u(height, width, CV_8U), src32f;
+	srand(0);
+	for (int i=0; i<height; i++) {
+		uchar *ptr = src8u.ptr<uchar>(i);
+		for (int j=0; j<width; j++) {
+			int v = (i*3 + j*5) % 256 + rand() % 32 - 16;
+			ptr[j] = static_cast<uchar>(v < 0 ? 0 : (v > 255 ? 255 : v));
+		}
+	}
+	src8u.convertTo(src32f, CV_32F);
+
+	// Windows of SSIM (11, 1.5) and of the four scales of VIFp (N, N/5)
+	const int ksizes[] = {11, 17, 9, 5, 3};
+	const double sigmas[] = {1.5, 17/5.0, 9/5.0, 5/5.0, 3/5.0};
+
+	printf("%dx%d, %d iterations, kernels: %s\n", width, height, iterations, ISA_NAME[Kernels::getISA()]);
+	printf("ksize  sigma  %10s %10s %10s %10s   (Mpixel/s, max abs diff)\n", IMPL_NAME[0], IMPL_NAME[1], IMPL_NAME[2], IMPL_NAME[3]);
+	for (size_t k=0; k<sizeof(ksizes)/sizeof(ksizes[0]); k++) {
+		int ksize = ksizes[k];
+		double sigma = sigmas[k];
+		double npixels = static_cast<double>(height-ksize+1)*(width-ksize+1)*iterations;
+		cv::Mat reference, dst;
+		filter(IMPL_OPENCV, src32f, src8u, reference, ksize, sigma);
+
+		double rate[IMPL_SIZE], diff[IMPL_SIZE];
+		for (int impl=0; impl<IMPL_SIZE; impl++) {
+			filter(impl, src32f, src8u, dst, ksize, sigma);
+			double duration = static_cast<double>(cv::getTickCount());
+			for (int it=0; it<iterations; it++) {
+				filter(impl, src32f, src8u, dst, ksize, sigma);
+			}
+			duration = (static_cast<double>(cv::getTickCount()) - duration) / cv::getTickFrequency();
+			rate[impl] = npixels / duration / 1e6;
+			diff[impl] = maxAbsDiff(reference, dst);
+		}
+		printf("%5d  %5.2f  %10.1f %10.1f %10.1f %10.1f\n", ksize, sigma, rate[0], rate[1], rate[2], rate[3]);
+		printf("              %10s %10.2g %10.2g %10.2g\n", "", diff[1], diff[2], diff[3]);
+	}
+
+	return EXIT_SUCCESS;
+}
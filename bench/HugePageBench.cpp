@@ -0,0 +1,164 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ dTLB misses and throughput of SSIM and VIFp with and without transparent
+ huge pages.
+
+ Usage:
+  hugepage_bench [Width Height [Iterations]]
+
+ Two random frames (default: 3840x2160, 10 iterations) are compared with
+ SSIM and VIFp on a single thread, first with the frame buffers and the
+ scratch matrices in 4 kB pages, then backed by 2 MB transparent huge
+ pages (see AlignedMat). For each mode, the throughput is given in
+ megapixels per second, along with the dTLB load misses per pixel (when
+ the hardware counters are available) and the amount of memory of the
+ process actually mapped by huge pages.
+
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <opencv2/core/core.hpp>
+#include "AlignedMat.hpp"
+#include "Kernels.hpp"
+#include "PerfCounters.hpp"
+#include "SSIM.hpp"
+#include "ThreadPool.hpp"
+#include "VIFP.hpp"
+
+enum Mode {
+	MODE_SMALL_PAGES,
+	MODE_HUGE_PAGES,
+	MODE_SIZE
+};
+
+static const char *MODE_NAME[MODE_SIZE] = {"4 kB pages", "huge pages"};
+
+// Anonymous memory of the process mapped by huge pages, in kB (-1 if unknown)
+static long anonHugePages()
+{
+	FILE *f = fopen("/proc/self/smaps_rollup", "r");
+	if (f == NULL) return -1;
+	char line[256];
+	long kb = -1;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (strncmp(line, "AnonHugePages:", 14) == 0) {
+			kb = strtol(line+14, NULL, 10);
+		}
+	}
+	fclose(f);
+	return kb;
+}
+
+// Random 8-bit frame with aligned rows, smoothed a little so that it looks like video
+static void randomFrame(cv::Mat& frame, int height, int width, int noise)
+{
+	AlignedMat::create(frame, height, width, CV_8U);
+	for (int i=0; i<height; i++) {
+		uchar *ptr = frame.ptr<uchar>(i);
+		for (int j=0; j<width; j++) {
+			int v = (i*3 + j*5) % 256 + rand() % noise - noise/2;
+			ptr[j] = static_cast<uchar>(v < 0 ? 0 : (v > 255 ? 255 : v));
+		}
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	int width = argc > 2 ? atoi(argv[1]) : 3840;
+	int height = argc > 2 ? atoi(argv[2]) : 2160;
+	int iterations = argc > 3 ? atoi(argv[3]) : 10;
+	if (width < 41 || height < 41 || iterations <= 0) {
+		fprintf(stderr, "Usage: hugepage_bench [Width Height [Iterations]]\n");
+		return EXIT_FAILURE;
+	}
+
+	// Everything on the calling thread, whose counters are sampled
+	ThreadPool::setNumThreads(1);
+	Kernels::init(NULL);
+
+	printf("%dx%d, %d iterations, kernels: %s\n", width, height, iterations, ISA_NAME[Kernels::getISA()]);
+	printf("%-12s %10s %10s %14s %12s   (Mpixel/s)\n", "", "SSIM", "VIFp", "dTLB-miss/px", "huge pages");
+	for (int mode=0; mode<MODE_SIZE; mode++) {
+		if (!AlignedMat::setHugePages(mode == MODE_HUGE_PAGES)) {
+			printf("%-12s not available\n", MODE_NAME[mode]);
+			continue;
+		}
+
+		// New buffers for each mode
+		cv::Mat original, processed;
+		srand(0);
+		randomFrame(original, height, width, 32);
+		randomFrame(processed, height, width, 48);
+		SSIM ssim(height, width);
+		VIFP vifp(height, width);
+
+		// First frame: allocation of the scratch matrices and pyramids
+		ssim.compute(original, processed);
+		vifp.compute(original, processed);
+
+		double rate[2];
+		uint64_t tlb_misses = 0;
+		bool tlb_valid = true;
+		for (int m=0; m<2; m++) {
+			PerfCounters::Sample begin = PerfCounters::read();
+			double duration = static_cast<double>(cv::getTickCount());
+			for (int it=0; it<iterations; it++) {
+				if (m == 0) {
+					ssim.compute(original, processed);
+				}
+				else {
+					vifp.compute(original, processed);
+				}
+			}
+			duration = (static_cast<double>(cv::getTickCount()) - duration) / cv::getTickFrequency();
+			PerfCounters::Sample end = PerfCounters::read();
+			rate[m] = static_cast<double>(width)*height*iterations / duration / 1e6;
+			tlb_valid = tlb_valid && begin.valid[PERF_DTLB_MISSES] && end.valid[PERF_DTLB_MISSES];
+			tlb_misses += end.value[PERF_DTLB_MISSES] - begin.value[PERF_DTLB_MISSES];
+		}
+
+		char tlb[32], huge[32];
+		if (tlb_valid) {
+			snprintf(tlb, sizeof(tlb), "%.4f", static_cast<double>(tlb_misses)/(2.0*width*height*iterations));
+		}
+		else {
+			snprintf(tlb, sizeof(tlb), "n/a");
+		}
+		long kb = anonHugePages();
+		if (kb >= 0) {
+			snprintf(huge, sizeof(huge), "%ld MB", kb/1024);
+		}
+		else {
+			snprintf(huge, sizeof(huge), "n/a");
+		}
+		printf("%-12s %10.1f %10.1f %14s %12s\n", MODE_NAME[mode], rate[0], rate[1], tlb, huge);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Frame buffers whose rows start on 64-byte boundaries.
+
+ Each row is padded with zeros to a multiple of 64 bytes (the row stride
+ is that size plus 64 bytes, used to align the start of the buffer). The
+ kernels can therefore process a row of such a matrix, or of a view of its
+ rows, in whole vectors of up to 64 bytes without a scalar tail: the extra
+ elements read are zeros, and the extra elements computed are discarded.
+
+ The padding also keeps the stride of power-of-two widths (e.g. 2048 or
+ 4096 samples) away from multiples of 4 kB, which would map the rows read
+ by the vertical filter passes to the same cache sets.
+
+ Buffers of 2 MB or more can be backed by transparent huge pages (Linux
+ only): they then start on a 2 MB boundary and are advised with
+ madvise(MADV_HUGEPAGE) before being touched, so that a 4K frame spans a
+ few 2 MB pages instead of thousands of 4 kB pages, and the dTLB misses of
+ the filter passes drop. Without kernel support, they are ordinary pages.
+
+ Scratch matrices of the metrics (filtered images and products of a row
+ band) are kept per thread and reused from one frame to the next, so
+ they are allocated, and their pages faulted in, only once. A thread keeps
+ a single buffer per scratch id, viewed with the shape of each request,
+ so its memory is bounded by the largest bands it has computed, whatever
+ the number of resolutions compared in the process.
+
+**************************************************************************/
+
+#ifndef AlignedMat_hpp
+#define AlignedMat_hpp
+
+#include <opencv2/core/core.hpp>
+
+class AlignedMat {
+public:
+	static const int ALIGNMENT = 64;
+	static const size_t HUGE_PAGE_SIZE = 2 << 20;
+	// Back the buffers created from now on with transparent huge pages,
+	// returns false if they are not supported (the setting is then ignored)
+	static bool setHugePages(bool enable);
+	// Create m as a rows x cols matrix of the given type with aligned and
+	// padded rows, nothing is done if it already is one
+	static void create(cv::Mat& m, int rows, int cols, int type);
+	// Scratch matrix of the calling thread: a view with aligned rows of the
+	// buffer kept for id, recreated only when it is too small. Its content
+	// is undefined (except for the padding), and it must not be used across
+	// calls that may run other tasks on the thread or request the same id
+	static cv::Mat scratch(int id, int rows, int cols, int type);
+	// Whether m (or the matrix whose rows it views) was created by create()
+	static bool isAligned(const cv::Mat& m);
+	// Number of columns to process to cover the first n columns of m: n
+	// rounded up to a multiple of 64 bytes if m is aligned, n otherwise
+	static int paddedCols(const cv::Mat& m, int n);
+private:
+	static bool huge_pages;
+};
+
+#endif
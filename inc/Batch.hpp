@@ -0,0 +1,98 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Comparison of many pairs of videos in one process.
+
+ A manifest lists one job per line, with the same arguments as the
+ command line (see Job); empty lines and lines starting with '#' are
+ ignored, and arguments containing spaces may be quoted with '"'. The
+ Output argument is the prefix of the output files of the job.
+
+ Several jobs run concurrently, each with its own pipeline, and the
+ metrics of their frames are computed by the shared work-stealing thread
+ pool, so the cores stay busy while a job reads its first frames or
+ writes its last ones. The longest jobs (frames times pixels) are
+ started first, so a long clip does not start last and run alone. A job
+ whose input cannot be read or output cannot be written fails without
+ stopping the others.
+
+ The statistics of the jobs run with --summary are also pooled over all
+ of them, e.g. for a video split into several jobs, and written to
+ <manifest>_summary.csv.
+
+**************************************************************************/
+
+#ifndef Batch_hpp
+#define Batch_hpp
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Job.hpp"
+#include "PerfCounters.hpp"
+#include "Pipeline.hpp"
+
+class Batch {
+public:
+	// Read the jobs of a manifest, exit if it cannot be read or a job is not valid
+	Batch(const char *manifest);
+	// Run the jobs, at most njobs at a time, with compute_threads frames
+	// per job computed concurrently and the given queue depths (0: default)
+	// perf may be NULL, or hold one set of counters per metric
+	// Return the number of jobs that failed
+	int run(int njobs, int compute_threads, const int depth[STAGE_SIZE-1], PerfCounters *const *perf);
+	// Number of jobs in the manifest
+	int size() const;
+	// Number of frames compared by the jobs that succeeded
+	long long getFrames() const;
+private:
+	// Run jobs until none is left
+	void runJobs();
+	// compared is set to the number of frames whose results were written
+	// (fewer with --sample, --resume or --align)
+	bool runJob(const Job& job, int& compared);
+
+	std::string manifest;
+	std::vector<Job> jobs;
+	// Indexes of the jobs, by decreasing cost
+	std::vector<size_t> order;
+	std::atomic<size_t> next;
+	std::atomic<int> done;
+	std::atomic<int> failed;
+	std::atomic<long long> frames;
+
+	int compute_threads;
+	int depth[STAGE_SIZE-1];
+	PerfCounters *const *perf;
+
+	// Statistics pooled over the jobs with --summary
+	std::mutex pooled_lock;
+	PooledStats pooled[METRIC_SIZE];
+	bool pooled_selected[METRIC_SIZE];
+};
+
+#endif
@@ -0,0 +1,103 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Output of the metrics over blocks of the frames, as grids of values.
+
+ The metrics sum their per-pixel terms over blocks of a base size, the
+ greatest common divisor of the requested sizes, within their usual
+ passes over the pixels (see MetricSet::setBlockSize). The grids of each
+ requested size are then added up from the base grid, and the sums turned
+ into values as for the whole frame:
+ - PSNR: from the mean squared error of the pixels of the block,
+ - SSIM: mean of the SSIM map over the windows centred in the block
+   (NaN for the blocks along the borders without any),
+ - PSNR-HVS and PSNR-HVS-M: from the mean errors of the 8x8 DCT blocks in
+   the block, so the sizes must be multiples of 8.
+ The last blocks of a row or column are cut by the border of the frame.
+
+ Each size is written to <prefix>_blocks<size>.bin, a compact binary file
+ with fixed-size records, so that the grids of any frame can be read by
+ seeking to it. All fields are little-endian:
+ - header: "VQMTGRID", then 32-bit unsigned integers: version (1), width,
+   height, block size, columns and rows of blocks, number of metrics M
+   and the index of each metric in Metrics (M values),
+ - one record per frame: the frame number as a 32-bit integer, then the
+   grid of each metric in the order of the header, as rows x columns
+   32-bit floats, row by row.
+ The record of the frame at position K (from 0) thus starts at byte
+ 36 + 4*M + K*(4 + 4*M*rows*columns).
+
+**************************************************************************/
+
+#ifndef BlockWriter_hpp
+#define BlockWriter_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "MetricSet.hpp"
+
+class BlockWriter {
+public:
+	// Write the grids of blocks of each size to <prefix>_blocks<size>.bin,
+	// for the selected metrics of METRIC_BLOCKS
+	BlockWriter(const std::string& prefix, int height, int width, const std::vector<int>& sizes, const bool selected[METRIC_SIZE]);
+	~BlockWriter();
+	// Size of the blocks over which the metrics sum (see MetricSet::setBlockSize)
+	int getBaseSize() const;
+	// Number of sums of a frame, as given by MetricSet::getBlockSums
+	int getFrameSums() const;
+	// Write the grids of a frame from its sums over the blocks of the base size
+	void write(int frame, const double *sums);
+	// Close the files
+	void close();
+private:
+	BlockWriter(const BlockWriter&);
+	BlockWriter& operator=(const BlockWriter&);
+
+	struct Grid {
+		int size;
+		int cols;
+		int rows;
+		FILE *file;
+		// Block of the grid of each base block
+		std::vector<int> block;
+		// Number of pixels and of SSIM windows of each block
+		std::vector<double> pixels;
+		std::vector<double> windows;
+	};
+
+	std::vector<int> metrics;
+	int base_size;
+	int base_cols;
+	int base_rows;
+	std::vector<Grid> grids;
+	// Sums of the current frame over the blocks of a grid, and its record
+	std::vector<double> sums;
+	std::vector<unsigned char> record;
+};
+
+#endif
@@ -0,0 +1,223 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Bounded multi-producer multi-consumer lock-free queue.
+
+ This is the array-based queue of Dmitry Vyukov: each cell carries a
+ sequence number telling whether it is ready to be written or read at a
+ given position, so producers and consumers only synchronise through
+ atomic operations. The blocking push() and pop() back off while the
+ queue is full or empty (yielding for the first 64 tries, then sleeping
+ 50 microseconds at a time), which provides backpressure between
+ pipeline stages.
+
+ The queue also records its mean occupancy and the time producers and
+ consumers spent blocked, to locate the bottleneck of a pipeline.
+
+**************************************************************************/
+
+#ifndef BoundedQueue_hpp
+#define BoundedQueue_hpp
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+template<typename T>
+class BoundedQueue {
+public:
+	BoundedQueue(size_t capacity) : cells(capacity > 0 ? capacity : 1)
+	{
+		for (size_t i=0; i<cells.size(); i++) {
+			cells[i].seq = i;
+		}
+		head = 0;
+		tail = 0;
+		closed = false;
+		occupancy_sum = 0;
+		occupancy_count = 0;
+		full_ns = 0;
+		empty_ns = 0;
+	}
+
+	size_t capacity() const
+	{
+		return cells.size();
+	}
+
+	// Approximate number of elements
+	size_t size() const
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_relaxed);
+		return t > h ? t - h : 0;
+	}
+
+	bool tryPush(const T& value)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos % cells.size()];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			if (seq == pos) {
+				if (tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+					cell.value = value;
+					cell.seq.store(pos+1, std::memory_order_release);
+					occupancy_sum += static_cast<long long>(size());
+					occupancy_count++;
+					return true;
+				}
+			}
+			else if (seq < pos) {
+				// Cell not read yet: full
+				return false;
+			}
+			else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool tryPop(T& value)
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell &cell = cells[pos % cells.size()];
+			size_t seq = cell.seq.load(std::memory_order_acquire);
+			if (seq == pos+1) {
+				if (head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+					value = cell.value;
+					cell.seq.store(pos+cells.size(), std::memory_order_release);
+					return true;
+				}
+			}
+			else if (seq < pos+1) {
+				// Cell not written yet: empty
+				return false;
+			}
+			else {
+				pos = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Wait until there is room for value, return false if the queue was closed
+	bool push(const T& value)
+	{
+		if (tryPush(value)) return true;
+		Clock::time_point start = Clock::now();
+		for (int spin=0; ; spin++) {
+			if (closed.load()) return false;
+			if (tryPush(value)) break;
+			backoff(spin);
+		}
+		full_ns += elapsed(start);
+		return true;
+	}
+
+	// Wait for an element, return false once the queue is closed and empty
+	bool pop(T& value)
+	{
+		if (tryPop(value)) return true;
+		Clock::time_point start = Clock::now();
+		for (int spin=0; ; spin++) {
+			bool was_closed = closed.load();
+			if (tryPop(value)) break;
+			if (was_closed) {
+				empty_ns += elapsed(start);
+				return false;
+			}
+			backoff(spin);
+		}
+		empty_ns += elapsed(start);
+		return true;
+	}
+
+	// No more elements will be pushed
+	void close()
+	{
+		closed = true;
+	}
+
+	// Mean number of elements in the queue after a push
+	double meanOccupancy() const
+	{
+		long long n = occupancy_count.load();
+		return n > 0 ? static_cast<double>(occupancy_sum.load())/static_cast<double>(n) : 0.0;
+	}
+
+	// Total time spent by producers waiting for room, in seconds
+	double fullTime() const
+	{
+		return static_cast<double>(full_ns.load())*1e-9;
+	}
+
+	// Total time spent by consumers waiting for elements, in seconds
+	double emptyTime() const
+	{
+		return static_cast<double>(empty_ns.load())*1e-9;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T value;
+	};
+
+	// No busy spinning: the stages wait for frames, i.e. milliseconds, and
+	// yielding leaves the core to the other threads
+	static void backoff(int spin)
+	{
+		if (spin < 64) {
+			std::this_thread::yield();
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	static long long elapsed(Clock::time_point start)
+	{
+		return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	}
+
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+	std::vector<Cell> cells;
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+	std::atomic<bool> closed;
+	std::atomic<long long> occupancy_sum;
+	std::atomic<long long> occupancy_count;
+	std::atomic<long long> full_ns;
+	std::atomic<long long> empty_ns;
+};
+
+#endif
@@ -44,6 +44,8 @@ public:
 	// Compute the PSNR index of the processed image
 	float compute(const cv::Mat& original, const cv::Mat& processed);
 
+	// Load the eye-tracking data of the sequence named in filename, replacing
+	// the data loaded before
 	bool match_eye_track_data(std::string filename);
 
     void set_frame_no(unsigned int no) { m_frame_no = no; };
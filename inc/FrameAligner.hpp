@@ -0,0 +1,105 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Temporal alignment of the processed video with the original one.
+
+ An encoder may start later in the content (offset), drop frames or
+ repeat frames, so that frame i of the processed video is no longer
+ frame i of the original one. Before the comparison, a fingerprint of
+ each frame of both videos is computed from ROWS rows of its luma only,
+ read without the rest of the frame and averaged over COLS segments each.
+
+ The frames are then matched by dynamic programming over the offsets of
+ at most max_offset frames between the videos. Each processed frame is
+ matched with the original frame following the previous match, with the
+ same one again (repeated frame, cost: penalty) or with one after k
+ skipped original frames (dropped frames, cost: k*penalty), the first
+ match being any of the first max_offset+1 original frames. The cost of
+ a match is the mean absolute difference of the fingerprints, and the
+ penalty is half the median difference between consecutive original
+ frames (at least MIN_PENALTY), so that a jump is only taken when it
+ matches the frames that follow better. Processed frames before the first original
+ frame or after the last one are left unmatched, at the same penalty
+ each. The time and memory are proportional to the number of frames
+ times the number of offsets (2*max_offset+1, max_offset being at most
+ MAX_OFFSET), and the rows read are a small fraction of the videos.
+
+ The comparison then reads the original frame matched with each processed
+ frame (see Pipeline::setAligner), its results being given for the frames
+ of the processed video, without the unmatched ones.
+
+**************************************************************************/
+
+#ifndef FrameAligner_hpp
+#define FrameAligner_hpp
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "VideoYUV.hpp"
+
+class FrameAligner {
+public:
+	// Alignment of videos of height x width pixels, offset by at most
+	// max_offset frames (at most MAX_OFFSET)
+	FrameAligner(int height, int width, int max_offset);
+	// Compute the fingerprints of the nbframes frames of both videos and
+	// match them. The positions of the videos are undefined afterwards
+	// Return false if a frame cannot be read
+	bool align(VideoYUV *original, VideoYUV *processed, int nbframes);
+	// Original frame matched with a processed frame, -1 if none
+	int getOriginal(int frame) const;
+	// Write the original frame matched with each processed frame to path
+	// (CSV), print the error and return false if it cannot be written
+	bool save(const std::string& path) const;
+	// Print the offset, the numbers of dropped, repeated and unmatched
+	// frames, and the time taken
+	void report(FILE *out) const;
+
+	static const int ROWS = 8;
+	static const int COLS = 16;
+	// Largest offset searched, which bounds the time and memory per frame
+	static const int MAX_OFFSET = 250;
+	static const double MIN_PENALTY;
+private:
+	// Fingerprints of the nbframes frames of video, ROWS*COLS values each
+	bool fingerprint(VideoYUV *video, int nbframes, std::vector<float>& prints);
+	// Mean absolute difference between two fingerprints
+	static double distance(const float *a, const float *b);
+
+	int height;
+	int width;
+	int max_offset;
+	// Original frame of each processed frame (-1: none)
+	std::vector<int> original_of;
+	int offset;
+	int dropped;
+	int repeated;
+	int unmatched;
+	double seconds;
+};
+
+#endif
@@ -0,0 +1,101 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Estimation of the average quality of a video from a sample of frames.
+
+ Frames are drawn in rounds: round r splits the video into 2^r strata of
+ consecutive frames and draws one frame at random in each stratum (not
+ drawn yet), visiting the strata in bit-reversed order. Whenever it
+ stops, the sample is thus spread evenly over the whole video, and it
+ grows until all frames have been drawn. The random generator has a fixed
+ seed, so that the same frames are drawn by each run.
+
+ The mean of each selected metric over the frames drawn is given with its
+ 95% confidence interval (normal approximation, with the finite
+ population correction), and sampling stops once the half width of the
+ interval of each metric is within a relative tolerance of its mean,
+ after at least MIN_SAMPLES frames. The variance of the scores is
+ estimated as for a simple random sample, which overestimates that of a
+ stratified sample when the quality varies over the video: the intervals
+ are conservative.
+
+**************************************************************************/
+
+#ifndef FrameSampler_hpp
+#define FrameSampler_hpp
+
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include "MetricSet.hpp"
+
+class FrameSampler {
+public:
+	// Sample frames among nbframes, until the confidence interval of each
+	// selected metric is within tolerance (e.g. 0.001 for 0.1%) of its mean
+	FrameSampler(int nbframes, const bool selected[METRIC_SIZE], double tolerance);
+	// Next frame to compare, -1 once all frames have been drawn
+	int next();
+	// Add the results of a frame drawn by next(), in any order, the NaN
+	// results (no score) and the infinite ones (e.g. PSNR of identical
+	// frames) being left out of the estimates
+	// Return true once the estimates are within the tolerance
+	bool add(const float result[METRIC_SIZE]);
+	// Print the estimates to out after 2^k frames (from MIN_SAMPLES frames
+	// on) and when they are within the tolerance, NULL not to
+	void setProgress(FILE *out);
+	// Number of frames added
+	int count() const;
+	double mean(int metric) const;
+	// Half width of the 95% confidence interval of the mean
+	double halfWidth(int metric) const;
+	// Print the estimates and their confidence intervals
+	void report(FILE *out) const;
+
+	static const int MIN_SAMPLES = 30;
+private:
+	bool converged() const;
+
+	// Frames drawn so far, and position in the current round
+	int nbframes;
+	std::vector<bool> drawn;
+	int ndrawn;
+	int round;
+	unsigned long long stratum;
+	std::mt19937 generator;
+
+	// Running mean and sum of squared deviations of each metric (Welford)
+	bool selected[METRIC_SIZE];
+	double tolerance;
+	int n;
+	// Frames with a finite score for each metric, out of n
+	int scored[METRIC_SIZE];
+	double mean_value[METRIC_SIZE];
+	double m2[METRIC_SIZE];
+	FILE *progress;
+};
+
+#endif
@@ -0,0 +1,84 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Separable Gaussian filtering of the 'valid' region only.
+
+ The output has ksize-1 fewer rows and columns than the input and only
+ contains the pixels computed without padding (similarly to 'filter2' in
+ Matlab with option 'valid'), so no border pixels are filtered and then
+ thrown away. Each output row is computed by a vertical pass over ksize
+ input rows into a row buffer, followed by a horizontal pass.
+
+ The filtering can be combined with a 2:1 subsampling in both directions,
+ in which case only the even rows and columns of the output are computed.
+
+ Kernels are computed once per (ksize, sigma) and shared by all callers.
+ 8-bit inputs can also be filtered in fixed point: coefficients with 15
+ fractional bits, and an intermediate row with 6 fractional bits. The
+ local moments of two 8-bit images (a, b, a*a, b*b and a*b as used by
+ SSIM) are filtered the same way, except that the horizontal pass uses
+ coefficients with 10 fractional bits so that all sums fit in 32 bits.
+
+**************************************************************************/
+
+#ifndef GaussianFilter_hpp
+#define GaussianFilter_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+class GaussianFilter {
+public:
+	// Filter of size ksize with standard deviation sigma
+	static const GaussianFilter& get(int ksize, double sigma);
+	// Filter a CV_32F or CV_8U image into a CV_32F image of
+	// (rows-ksize+1) x (cols-ksize+1), dst is allocated if needed
+	void apply(const cv::Mat& src, cv::Mat& dst) const;
+	// Same as apply followed by keeping the even rows and columns only, for
+	// the dst.rows x dst.cols preallocated CV_32F output
+	void applyDecimated(const cv::Mat& src, cv::Mat& dst) const;
+	// Same as apply for CV_8U images, in fixed point
+	void applyFixed(const cv::Mat& src, cv::Mat& dst) const;
+	// Filter a, b, a.*a, b.*b and a.*b for CV_8U images a and b in fixed point,
+	// into mu1, mu2, e11, e22 and e12 respectively (allocated as for apply)
+	void applyMomentsFixed(const cv::Mat& a, const cv::Mat& b, cv::Mat& mu1, cv::Mat& mu2, cv::Mat& e11, cv::Mat& e22, cv::Mat& e12) const;
+	int getSize() const;
+	// Fractional bits of the fixed-point coefficients and intermediate row
+	static const int COEFF_BITS = 15;
+	static const int ROW_BITS = 6;
+	static const int MOMENTS_COEFF_BITS = 10;
+private:
+	GaussianFilter(int ksize, double sigma);
+	int ksize;
+	std::vector<float> coeffs;
+	// Even and odd taps, for the subsampled output
+	std::vector<float> even_coeffs;
+	std::vector<float> odd_coeffs;
+	std::vector<int> fixed_coeffs;
+	std::vector<int> moments_coeffs;
+};
+
+#endif
@@ -0,0 +1,119 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Parameters of the comparison of two videos.
+
+ A job is given by the arguments of the command line, or by a line of a
+ batch manifest with the same arguments:
+  OriginalVideo ProcessedVideo Height Width NumberOfFrames ChromaFormat Output Metrics
+ The options that only apply to one comparison (--stride=N, --ssim-fixed,
+ --summary, --sample=TOL, --live=FPS, --deadline=MS, --blocks=SIZES,
+ --maps=BITS, --roi-mask=FILE, --roi-rects=FILE, --align=N, --checkpoint=N
+ and --resume) may be given among the metrics, the other options are left
+ to the caller.
+
+**************************************************************************/
+
+#ifndef Job_hpp
+#define Job_hpp
+
+#include <string>
+#include <vector>
+#include "BlockWriter.hpp"
+#include "FrameAligner.hpp"
+#include "LiveScheduler.hpp"
+#include "MapWriter.hpp"
+#include "MetricSet.hpp"
+#include "ResultWriter.hpp"
+#include "WeightMask.hpp"
+
+struct Job {
+	Job();
+	// Parse the arguments of a job (without the program name)
+	// Print the error and return false if they are not valid
+	bool parse(const std::vector<std::string>& args);
+	// Number of luma samples to compare, used to start the longest jobs first
+	double getCost() const;
+	// Arguments of the job, as given to parse(), without the other options
+	std::vector<std::string> getArguments() const;
+	// Arguments that a checkpoint has to match to be resumed
+	std::string getCheckpointKey() const;
+	// Scheduler of the metrics with --live=FPS, logging to <prefix>_live.csv,
+	// NULL otherwise
+	LiveScheduler *createScheduler(const std::string& prefix) const;
+	// Writer of the grids of blocks with --blocks=SIZES, to
+	// <prefix>_blocks<size>.bin, NULL otherwise
+	BlockWriter *createBlockWriter(const std::string& prefix) const;
+	// Writer of the maps with --maps=BITS, to <prefix>_<metric>_map.bin,
+	// NULL otherwise
+	MapWriter *createMapWriter(const std::string& prefix) const;
+	// Weights of the pixels with --roi-mask=FILE or --roi-rects=FILE, NULL
+	// otherwise. Print the error and return false if they cannot be read
+	bool createWeightMask(WeightMask *&mask) const;
+	// Aligner of the videos with --align=N, NULL otherwise
+	FrameAligner *createAligner() const;
+	// Open the output files <prefix>_<metric>.csv (and <prefix>_summary.csv with
+	// --summary), continued from the checkpoint <prefix>.checkpoint with
+	// --resume, and checkpointed with --checkpoint=N
+	// first_frame is set to the frame to start from. Print the error and
+	// return NULL if the files cannot be opened or the checkpoint cannot be
+	// resumed
+	ResultWriter *createWriter(const std::string& prefix, bool echo, int& first_frame) const;
+	// Split a line into arguments separated by blanks, '"' quotes arguments
+	// containing blanks. Return false if a quote is not closed
+	static bool split(const std::string& line, std::vector<std::string>& args);
+	// Inverse of split()
+	static std::string join(const std::vector<std::string>& args);
+	// Parse the value of option "name=value" as a positive integer
+	// Print the error and return -1 if it is not valid
+	static int parseOption(const char *arg, const char *name);
+
+	std::string original;	// original video stream (YUV)
+	std::string processed;	// processed video stream (YUV)
+	std::string output;	// prefix of the output files
+	int height;
+	int width;
+	int nbframes;
+	int chroma;		// one of ChromaSubsampling or PackedFormat
+	int stride;		// bytes between two rows of luma in the files (0: not padded)
+	bool selected[METRIC_SIZE];
+	bool ssim_fixed;
+	bool summary;		// write the pooled statistics to a summary file
+	double sample;		// tolerance of the estimates from a sample of frames (0: all frames, see FrameSampler)
+	double live;		// frame rate of a live source (0: not live, see LiveScheduler)
+	double deadline;	// maximum lag of a frame of a live source, in milliseconds (0: one frame)
+	std::vector<int> blocks;	// sizes of the blocks of the grids written (none: no grids, see BlockWriter)
+	int maps;		// bits of the quantized maps written (0: no maps, see MapWriter)
+	std::string roi_mask;	// mask video of the weights of the pixels (empty: none, see WeightMask)
+	std::string roi_rects;	// rectangles of the weights of the pixels (empty: none)
+	int align;		// maximum offset between the videos when aligning them (0: not aligned, see FrameAligner)
+	int checkpoint;		// frames between two checkpoints (0: none)
+	bool resume;		// resume from the last checkpoint, if any
+	// Options that are not specific to the job, in the order given
+	std::vector<std::string> options;
+};
+
+#endif
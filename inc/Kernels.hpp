@@ -0,0 +1,129 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Hand-vectorized kernels with run-time instruction set selection.
+
+ The hot loops of the metrics are compiled several times, once per
+ instruction set (baseline, SSE4.2, AVX2 and AVX-512 on x86), and the best
+ variant supported by the CPU is selected at startup. The selection can be
+ forced with the VQMT_ISA environment variable or the --isa= option.
+
+ All variants perform the same floating-point operations in the same order
+ (no FMA contraction, same summation order as Reduction::sumRow), so the
+ results do not depend on the selected instruction set.
+
+**************************************************************************/
+
+#ifndef Kernels_hpp
+#define Kernels_hpp
+
+#include <cstddef>
+
+enum KernelISA {
+	ISA_BASELINE,
+	ISA_SSE42,
+	ISA_AVX2,
+	ISA_AVX512,
+	ISA_SIZE
+};
+
+// Names accepted by --isa= and VQMT_ISA
+extern const char *ISA_NAME[];
+
+struct KernelTable {
+	// Sum of the n elements of a row, in the order of Reduction::sumRow
+	double (*sumRow)(const float *row, int n);
+	// Sum of the squared differences between two rows
+	double (*sumSquaredDiff)(const float *a, const float *b, int n);
+	// Same as sumSquaredDiff on 8-bit rows, exact
+	double (*sumSquaredDiff8u)(const unsigned char *a, const unsigned char *b, int n);
+	// Sum of the squared differences weighted by the elements of weights
+	double (*sumSquaredDiffWeighted)(const float *a, const float *b, const float *weights, int n);
+	double (*sumSquaredDiffWeighted8u)(const unsigned char *a, const unsigned char *b, const float *weights, int n);
+	// Products of two rows: xx = x.*x, yy = y.*y, xy = x.*y
+	void (*moments)(const float *x, const float *y, float *xx, float *yy, float *xy, int n);
+	void (*moments8u)(const unsigned char *x, const unsigned char *y, float *xx, float *yy, float *xy, int n);
+	// SSIM and contrast maps of a row from the filtered images (mu1, mu2)
+	// and the filtered products (e11, e22, e12), returns the sums of both maps
+	void (*ssimRow)(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, int n, double *ssim_sum, double *cs_sum);
+	// Same as ssimRow, also adding the SSIM map of element j to
+	// blocks[(j+first)/size] and storing it in map[j], blocks or map may be NULL
+	void (*ssimRowMap)(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, int n, int first, int size, double *ssim_sum, double *cs_sum, double *blocks, float *map);
+	// Same as ssimRow, with both maps weighted by the elements of weights
+	void (*ssimRowWeighted)(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, const float *weights, int n, double *ssim_sum, double *cs_sum);
+	// Natural logarithms of the numerator and denominator terms of VIFp for a
+	// row, from the filtered images and products, returns the sums of both
+	void (*vifpRow)(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float sigma_nsq, int n, double *num_sum, double *den_sum);
+	// Same as vifpRow, also storing the ratio of the terms of each element
+	// in map (1 where the denominator is 0)
+	void (*vifpRowMap)(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float sigma_nsq, int n, double *num_sum, double *den_sum, float *map);
+	// Vertical pass of a separable filter: dst[x] = sum_t kernel[t]*src[t*step+x]
+	void (*convolveColumn)(const float *src, size_t step, const float *kernel, int ksize, float *dst, int n);
+	void (*convolveColumn8u)(const unsigned char *src, size_t step, const float *kernel, int ksize, float *dst, int n);
+	// Horizontal pass of a separable filter: dst[x] = sum_t kernel[t]*src[x+t]
+	void (*convolveRow)(const float *src, const float *kernel, int ksize, float *dst, int n);
+	// Same as convolveRow, adding to dst
+	void (*convolveRowAdd)(const float *src, const float *kernel, int ksize, float *dst, int n);
+	// Split a row into its even and odd elements
+	void (*deinterleave)(const float *src, float *even, float *odd, int n);
+	// 2:1 downsampling of two rows of n elements by averaging 2x2 blocks,
+	// into (n+1)/2 elements (the last element is repeated when n is odd)
+	void (*downsample2x2)(const float *row0, const float *row1, float *dst, int n);
+	void (*downsample2x2_8u)(const unsigned char *row0, const unsigned char *row1, float *dst, int n);
+	// Fixed-point passes on 8-bit input: the vertical pass rounds its integer
+	// sums to shift bits less, the horizontal pass converts them to float
+	void (*convolveColumnFixed)(const unsigned char *src, size_t step, const int *kernel, int ksize, int shift, unsigned short *dst, int n);
+	void (*convolveRowFixed)(const unsigned short *src, const int *kernel, int ksize, float scale, float *dst, int n);
+	// Vertical pass of a, b, a*a, b*b and a*b at once, on 8-bit input
+	void (*momentsColumnFixed)(const unsigned char *a, const unsigned char *b, size_t step, const int *kernel, int ksize, int shift, unsigned short *mu1, unsigned short *mu2, unsigned int *e11, unsigned int *e22, unsigned int *e12, int n);
+	// Same as convolveRowFixed on 32-bit input, the sums must fit in 32 bits
+	void (*convolveRowFixed32)(const unsigned int *src, const int *kernel, int ksize, float scale, float *dst, int n);
+	// Orthonormal 2D DCT of an 8x8 block, src rows are step elements apart
+	void (*dct8x8)(const float *src, size_t step, float *dst);
+	// Unpacking of the samples of a file into 8-bit planes, for n pairs of samples:
+	// - split pairs of 8-bit samples (or 16-bit little-endian ones, rounded to 8 bits)
+	void (*deinterleave8u)(const unsigned char *src, unsigned char *even, unsigned char *odd, int n);
+	void (*deinterleave16to8u)(const unsigned char *src, unsigned char *even, unsigned char *odd, int n);
+	// - round 16-bit little-endian samples to 8 bits
+	void (*narrow16to8u)(const unsigned char *src, unsigned char *dst, int n);
+	// - split packed 4:2:2 samples, Y0 U Y1 V (YUYV) or U Y0 V Y1 (UYVY)
+	void (*unpackYUYV)(const unsigned char *src, unsigned char *y, unsigned char *u, unsigned char *v, int n);
+	void (*unpackUYVY)(const unsigned char *src, unsigned char *y, unsigned char *u, unsigned char *v, int n);
+};
+
+class Kernels {
+public:
+	// Select the kernels: the given instruction set if not NULL, otherwise
+	// the one in VQMT_ISA if set, otherwise the best one supported by the CPU
+	static void init(const char *isa);
+	// Kernels currently selected (baseline until init is called)
+	static const KernelTable& get();
+	static KernelISA getISA();
+	// Whether the instruction set was compiled in and is supported by the CPU
+	static bool supported(KernelISA isa);
+};
+
+#endif
@@ -0,0 +1,111 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Scheduling of the metrics of a live source, with a deadline per frame.
+
+ The frames of a live source are due at a fixed rate: frame i is due
+ i/fps seconds after the start, and is read no earlier (a source that
+ is a file is thus read at the rate of a live one). The lag of a frame
+ is the time between its due time and the writing of its results; a
+ frame is late when its lag exceeds the deadline.
+
+ PSNR is cheap and computed for every frame. The other metrics, EWPSNR
+ included (its weight map is computed for every pixel of each frame),
+ are expensive: they are computed every Nth frame only. The lag is
+ averaged over windows of max(WINDOW, 2N) frames read after the last
+ change of N. N is doubled (up to MAX_INTERVAL) when the mean lag
+ of a window exceeds the deadline and has not decreased since the
+ previous window (the backlog is not being caught up), and halved once
+ the mean lag has stayed within half the deadline for a second of
+ frames. N is 1 as long as the metrics keep up with the source.
+
+ The metrics computed for each frame and its lag are written to a log,
+ the changes of N are printed as they happen, and report() prints the
+ lag statistics and the number of frames of each metric.
+
+**************************************************************************/
+
+#ifndef LiveScheduler_hpp
+#define LiveScheduler_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include "MetricSet.hpp"
+
+class LiveScheduler {
+public:
+	// fps: rate of the source, deadline: maximum lag of a frame, in seconds
+	// log: path of the log of the frames, written as "frame,lag_ms,metrics"
+	LiveScheduler(double fps, double deadline, const bool selected[METRIC_SIZE], const std::string& log);
+	~LiveScheduler();
+	// Start the clock, when the first frame is due
+	void start();
+	// Wait until the frame at position index (from 0) is due
+	void waitDue(int index) const;
+	// Metrics to compute for the frame at position index, read after
+	// those before it
+	void plan(int index, bool active[METRIC_SIZE]);
+	// Record that the results of the frame at position index have been
+	// written, frames are recorded in order
+	void done(int index, int frame, const bool active[METRIC_SIZE]);
+	// Print the lag statistics and the number of frames of each metric
+	void report(FILE *out) const;
+
+	static const int MAX_INTERVAL = 64;
+	static const int WINDOW = 8;
+private:
+	// Seconds since start()
+	double now() const;
+
+	double fps;
+	double deadline;
+	bool selected[METRIC_SIZE];
+	FILE *log;
+	long long start_ns;
+
+	// Interval of the expensive metrics, set by done() and read by plan()
+	std::atomic<int> interval;
+	// Position of the last frame planned, and of the last one planned when
+	// the interval changed: only frames read after a change tell its effect
+	std::atomic<int> last_planned;
+	int last_change;
+	// Frames and sum of their lags in the current window, mean lag of the
+	// previous one, and frames in a row in windows within half the deadline
+	int window_frames;
+	double window_lag;
+	double previous_lag;
+	int calm;
+
+	int frames;
+	int late;
+	double lag_sum;
+	double lag_max;
+	int computed[METRIC_SIZE];
+	int max_interval;
+};
+
+#endif
@@ -47,6 +47,7 @@
 #define MSSSIM_hpp
 
 #include "SSIM.hpp"
+#include "Pyramid.hpp"
 
 class MSSSIM : protected SSIM {
 public:
@@ -54,16 +55,33 @@ public:
 	// Compute the SSIM and MS-SSIM indexes of the processed image
 	// Return the MS-SSIM index
 	float compute(const cv::Mat& original, const cv::Mat& processed);
+	// Same as compute, from MS-SSIM pyramids that have already been built
+	float compute(const Pyramid& original, const Pyramid& processed);
 	// Return the SSIM index only
 	// compute() needs to be called before getSSIM()
 	float getSSIM();
 	// Return the MS-SSIM index only
 	// compute() needs to be called before getMSSSIM()
 	float getMSSSIM();
+	// Sums over blocks and map of the SSIM index, see SSIM
+	using SSIM::setBlockSize;
+	using SSIM::getBlockSums;
+	using SSIM::setMapEnabled;
+	using SSIM::getMap;
+	// Weighted SSIM of each level with setWeights, from the weights
+	// averaged over 2x2 blocks as the images. The indexes are NaN if the
+	// windows of the first level have no weight, and a coarser level whose
+	// windows have none is not weighted
+	using SSIM::setWeights;
 private:
 	double ssim;
 	double msssim;
-	static const int NLEVS = 5;
+	// Pyramids of the images given to compute()
+	Pyramid original_pyramid;
+	Pyramid processed_pyramid;
+	// Pyramid of the weights of the pixels
+	Pyramid weight_pyramid;
+	static const int NLEVS = Pyramid::MSSSIM_LEVELS;
 	static const double WEIGHT[];
 };
 
@@ -0,0 +1,135 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Compressed output of the maps of SSIM and VIFp, for debugging artifacts.
+
+ The compute threads quantize the maps of each frame to 8 or 16 bits, into
+ buffers taken from a fixed pool, and queue them to background workers
+ which compress them (zlib at its fastest level, after replacing each
+ element by its difference with the previous one of its row, for the
+ smooth areas of the maps) and write them. There are as many workers as
+ threads computing the metrics, since one zlib stream per core is needed
+ to keep up with metrics computed on all cores (e.g. SSIM at 4K). Each
+ worker compresses whole frames, and the records are written in the
+ order in which they are compressed, the index giving their offsets.
+ The compute threads only wait when all the buffers are queued, i.e. when
+ the compression falls behind for more frames than the pool holds.
+
+ Each metric is written to <prefix>_<metric>_map.bin, a container in which
+ any frame can be decoded without the others. All fields are little-endian:
+ - header: "VQMTMAPS", then 32-bit unsigned integers: version (1), width
+   and height of the maps, border (element (i, j) of a map is the window
+   centred on pixel (i+border, j+border)) and bits, then the 32-bit float
+   values of the smallest and the largest quantized values: element q of
+   a map stands for min + q*(max-min)/(2^bits-1),
+ - one record per frame, in the order in which they are compressed: the
+   frame number and the size of the zlib stream that follows, as 32-bit
+   unsigned integers, then the stream: the elements of the map row by row,
+   as 8 or 16-bit unsigned integers, each minus the previous one of its
+   row modulo 2^bits,
+ - once all frames are written: the index, i.e. the number of records,
+   then the frame number (32 bits) and the offset (64 bits) of each
+   record, then the offset of the index (64 bits) and "VQMTMEND".
+ A viewer reads the last 16 bytes, then the index, and seeks to the record
+ of the frame. A file whose run was interrupted has no index but can be
+ read record by record.
+ - SSIM: the SSIM map (of the SSIM from MS-SSIM when it is selected), in
+   [-1, 1], border 5
+ - VIFp: the ratio of the numerator and denominator terms at the finest
+   scale, clamped to [0, 2], border 8
+
+**************************************************************************/
+
+#ifndef MapWriter_hpp
+#define MapWriter_hpp
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "BoundedQueue.hpp"
+#include "MetricSet.hpp"
+
+class MapWriter {
+public:
+	// Write the maps of the selected metrics of METRIC_MAPS, quantized to
+	// bits (8 or 16), to <prefix>_<metric>_map.bin
+	// workers: number of compression threads, 0 for one per thread of the
+	// ThreadPool
+	// depth: number of frames whose maps can wait for the compression, at
+	// least two per worker
+	MapWriter(const std::string& prefix, int height, int width, int bits, const bool selected[METRIC_SIZE], int workers = 0, int depth = DEFAULT_DEPTH);
+	~MapWriter();
+	// Quantize the maps of the last frame computed by metrics and queue them
+	// for compression. Frames can be added by several threads, in any order
+	void add(int frame, const MetricSet& metrics);
+	// Compress the maps queued, write the indexes and close the files
+	void close();
+	// Print the number of maps, their compressed size and the time the
+	// compute threads waited for the compression
+	void report(FILE *out) const;
+
+	static const int DEFAULT_DEPTH = 8;
+private:
+	MapWriter(const MapWriter&);
+	MapWriter& operator=(const MapWriter&);
+
+	// Quantized maps of a frame
+	struct Frame {
+		int frame;
+		cv::Mat map[METRIC_SIZE];	// empty if the metric was not computed
+	};
+	struct Output {
+		FILE *file;
+		int border;
+		float min;
+		float max;
+		// Frame number and offset of each record
+		std::vector<std::pair<int, long long> > index;
+		long long bytes;
+	};
+	typedef BoundedQueue<Frame*> FrameQueue;
+
+	// Compress and write the frames queued, until the queue is closed
+	// (run by each worker)
+	void compressFrames();
+
+	bool selected[METRIC_SIZE];
+	int bits;
+	Output output[METRIC_SIZE];
+	std::vector<Frame*> frames;
+	FrameQueue *free_frames;
+	FrameQueue *queued;
+	std::vector<std::thread> workers;
+	// Records, index and sizes of the outputs written by the workers
+	std::mutex write_lock;
+	bool closed;
+	long long pixels;
+};
+
+#endif
@@ -34,9 +34,24 @@ public:
 	Metric(int height, int width);
 	virtual ~Metric();
 	virtual float compute(const cv::Mat& original, const cv::Mat& processed) = 0;
+	// Number of rows per band when splitting an output of the given height among threads
+	static int bandHeight(int rows);
+	// Also sum the metric over the size x size blocks of the images (0: no
+	// blocks), the last blocks of a row or column being cut by the border
+	void setBlockSize(int size);
+	// Weight the pixels of the next images by weights (CV_32F, of the size of
+	// the images, empty: no weights), all weights out of bounds being zero
+	void setWeights(const cv::Mat& weights, const cv::Rect& bounds);
 protected:
 	int height;
 	int width;
+	// Size (0: no blocks), number of columns and rows of the blocks
+	int block_size;
+	int block_cols;
+	int block_rows;
+	// Weights of the pixels (empty: none) and the rectangle out of which they are zero
+	cv::Mat pixel_weights;
+	cv::Rect weight_bounds;
 	// Smoothing using a Gaussian kernel of size ksize with standard deviation sigma
 	// Returns only those parts of the correlation that are computed without zero-padded edges
 	// (similarly to 'filter2' in Matlab with option 'valid')
@@ -0,0 +1,149 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Set of metric instances for one resolution.
+
+ The selected metrics of a frame are run concurrently as the tasks of a
+ task graph. The metric classes keep intermediate results between
+ compute() and their getters, so a MetricSet must only be used by one
+ thread at a time: concurrent frames need one MetricSet each.
+
+ The pyramids of MS-SSIM and VIFp are built once per frame by their own
+ tasks, concurrently for the original and processed images, before the
+ metrics that use them.
+
+ Some of the selected metrics may be left out of a frame (see
+ LiveScheduler): their tasks, and those of their pyramids, then return
+ at once.
+
+**************************************************************************/
+
+#ifndef MetricSet_hpp
+#define MetricSet_hpp
+
+#include <opencv2/core/core.hpp>
+#include "PSNR.hpp"
+#include "SSIM.hpp"
+#include "MSSSIM.hpp"
+#include "VIFP.hpp"
+#include "PSNRHVS.hpp"
+#include "EWPSNR.hpp"
+#include "PerfCounters.hpp"
+#include "Pyramid.hpp"
+#include "TaskGraph.hpp"
+
+enum Metrics {
+	METRIC_PSNR = 0,
+	METRIC_SSIM,
+	METRIC_MSSSIM,
+	METRIC_VIFP,
+	METRIC_PSNRHVS,
+	METRIC_PSNRHVSM,
+	METRIC_EWPSNR,
+	METRIC_SIZE
+};
+
+// Names of the metrics on the command line
+extern const char *METRIC_NAME[METRIC_SIZE];
+// Metrics that can also be summed over blocks (see MetricSet::setBlockSize)
+extern const bool METRIC_BLOCKS[METRIC_SIZE];
+// Metrics whose maps can be kept (see MetricSet::setMapsEnabled)
+extern const bool METRIC_MAPS[METRIC_SIZE];
+// Metrics that can weight the pixels (see MetricSet::setWeights)
+extern const bool METRIC_WEIGHTS[METRIC_SIZE];
+
+class MetricSet {
+public:
+	// original_file is used to find the eye-tracking data of EWPSNR
+	// perf may be NULL, or hold one set of counters per metric (which may be NULL)
+	// ssim_fixed: compute SSIM in fixed point (unless it comes from MS-SSIM)
+	MetricSet(int height, int width, const bool selected[METRIC_SIZE], bool ssim_fixed, const char *original_file, PerfCounters *const *perf);
+	~MetricSet();
+	// Compute the selected metrics of one frame, given as CV_8U images
+	// (or CV_32F images, except for the fixed-point SSIM)
+	// active: metrics to compute for this frame, NULL for all selected ones
+	void compute(const cv::Mat& original, const cv::Mat& processed, int frame, float result[METRIC_SIZE], const bool *active = NULL);
+	// Also sum the metrics of METRIC_BLOCKS over the size x size blocks of
+	// the frames (0: no blocks), within the same passes over the pixels
+	void setBlockSize(int size);
+	// Sums over the blocks of the last frame, for each selected metric of
+	// METRIC_BLOCKS in the order of Metrics, one grid of blocks after the
+	// other, row by row (see the getBlockSums of the metrics); NaN for the
+	// metrics not computed for this frame
+	void getBlockSums(double *sums) const;
+	// Also keep the maps of the selected metrics of METRIC_MAPS (see the
+	// getMap of the metrics)
+	void setMapsEnabled(bool enable);
+	// Map of a selected metric of METRIC_MAPS for the last frame, empty if
+	// the metric was not computed for this frame
+	cv::Mat getMap(int metric) const;
+	// Weight the pixels of the next frames by weights (CV_32F, of the size
+	// of the frames, empty: no weights), all weights out of bounds being
+	// zero, in the metrics of METRIC_WEIGHTS
+	void setWeights(const cv::Mat& weights, const cv::Rect& bounds);
+	// Compare the next frames to another original video, whose file name is
+	// used to find the eye-tracking data of EWPSNR
+	void setOriginal(const char *original_file);
+private:
+	MetricSet(const MetricSet&);
+	MetricSet& operator=(const MetricSet&);
+	PerfCounters *counters(int metric) const;
+	// Whether metric is computed for the current frame
+	bool isActive(int metric) const;
+	// Same as isActive, for the SSIM obtained from MS-SSIM too
+	bool isComputed(int metric) const;
+	// Add the tasks building the pyramids of a type for metric, return their identifiers
+	std::vector<int> addPyramidTasks(PyramidType type, int metric);
+
+	bool selected[METRIC_SIZE];
+	PerfCounters *const *perf;
+	int rows;
+	int cols;
+	long long npixels;
+	// Number of blocks of a frame
+	int nblocks;
+
+	PSNR *psnr;
+	SSIM *ssim;
+	MSSSIM *msssim;
+	VIFP *vifp;
+	PSNRHVS *phvs;
+	EWPSNR *ewpsnr;
+
+	// Pyramids of the current frame
+	Pyramid *original_pyramid[PYRAMID_SIZE];
+	Pyramid *processed_pyramid[PYRAMID_SIZE];
+
+	// Tasks of a frame and their current inputs and outputs
+	TaskGraph graph;
+	const cv::Mat *original_frame;
+	const cv::Mat *processed_frame;
+	int frame_no;
+	float *result;
+	const bool *active;
+};
+
+#endif
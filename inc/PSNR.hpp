@@ -31,6 +31,7 @@
 #ifndef PSNR_hpp
 #define PSNR_hpp
 
+#include <vector>
 #include "Metric.hpp"
 
 class PSNR : protected Metric {
@@ -38,6 +39,18 @@ public:
 	PSNR(int height, int width);
 	// Compute the PSNR index of the processed image
 	float compute(const cv::Mat& original, const cv::Mat& processed);
+	using Metric::setBlockSize;
+	// Sums of the squared errors over the blocks of the last images (see
+	// setBlockSize), row by row
+	void getBlockSums(double *sums) const;
+	// Weighted mean squared error with setWeights (NaN if all the weights
+	// are zero)
+	using Metric::setWeights;
+private:
+	std::vector<double> block_sums;
+	// Mean squared error weighted by the pixel weights, within their bounds
+	// Return false if the weights are all zero
+	bool computeWeightedMSE(const cv::Mat& original, const cv::Mat& processed, double& mse) const;
 };
 
 #endif
@@ -53,6 +53,7 @@
 #ifndef PSNRHVS_hpp
 #define PSNRHVS_hpp
 
+#include <vector>
 #include "Metric.hpp"
 
 class PSNRHVS : protected Metric {
@@ -67,11 +68,35 @@ public:
 	// Return the PSNR-HVS-M index only
 	// compute() needs to be called before getPSNRHVSM()
 	float getPSNRHVSM();
+	using Metric::setBlockSize;
+	// Sums of the errors of PSNR-HVS-M and PSNR-HVS (s1 and s2 before their
+	// division by the number of pixels) over the blocks of the last images
+	// (see setBlockSize, multiple of 8), row by row, either may be NULL
+	void getBlockSums(double *hvsm, double *hvs) const;
+	// Errors of each 8x8 block weighted by the mean weight of its pixels
+	// with setWeights: the blocks without weight are skipped, and both
+	// indexes are NaN if all the weights are zero
+	using Metric::setWeights;
 private:
 	float psnrhvs;
 	float psnrhvsm;
 	static const float CSF[8][8];
 	static const float MASK[8][8];
+	// Sums of s1 and s2 over the blocks of each row of 8x8 blocks, interleaved,
+	// then of the blocks
+	std::vector<double> block_row_sums;
+	std::vector<double> block_s1;
+	std::vector<double> block_s2;
+	// Accumulate the errors of the 8x8 blocks of columns [x_begin, x_end) in
+	// the rows of blocks [begin, end) in s1_rows and s2_rows, and in
+	// row_blocks (2*block_cols per row) if not NULL. If weight_rows is not
+	// NULL, the errors are weighted and the sums of the weights of the rows
+	// accumulated in weight_rows
+	void computeBlockRows(const cv::Mat& original, const cv::Mat& processed, int begin, int end, int x_begin, int x_end, double *s1_rows, double *s2_rows, double *row_blocks, double *weight_rows);
+	// Compute the weighted indexes, NaN if the weights are all zero
+	void computeWeighted(const cv::Mat& original, const cv::Mat& processed);
+	// Set the indexes from the mean errors s1 and s2
+	void setIndexes(double s1, double s2);
 	float maskeff(const cv::Mat &z, const cv::Mat &zdct);
 	float vari(const cv::Mat &z);
 };
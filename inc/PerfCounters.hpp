@@ -0,0 +1,101 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Optional sampling of hardware performance counters (cycles, instructions,
+ last-level cache misses, branch misses and dTLB load misses) around the
+ metric computations.
+
+ Counters are opened per thread through perf_event_open (Linux only) and
+ each measurement is the difference between two readings taken on the
+ calling thread. The work that a metric hands to the other threads of the
+ pool (ThreadPool::parallelFor) is measured on them and added to the same
+ metric, and a scope pauses the enclosing scope of its thread, so that the
+ tasks of other metrics that a thread runs while it waits are not counted
+ twice. When the counters cannot be opened (no kernel support,
+ restrictive perf_event_paranoid, containers, ...), sampling is disabled
+ and the measured code runs unchanged.
+
+**************************************************************************/
+
+#ifndef PerfCounters_hpp
+#define PerfCounters_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <mutex>
+
+// Hardware events sampled around each metric
+enum PerfEvent {
+	PERF_CYCLES = 0,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_EVENT_SIZE
+};
+
+class PerfCounters {
+public:
+	// Counter values of the calling thread at a given instant
+	struct Sample {
+		uint64_t value[PERF_EVENT_SIZE];
+		bool valid[PERF_EVENT_SIZE];
+	};
+	PerfCounters(const char *name);
+	// Return true if at least one hardware counter can be opened
+	static bool available();
+	// Read the counters of the calling thread
+	static Sample read();
+	// Accumulate the counts elapsed since begin for a computation over npixels
+	// pixels, or for a part of a computation counted elsewhere if npixels is 0
+	void accumulate(const Sample& begin, long long npixels);
+	// Print the accumulated counts, IPC and misses per pixel
+	void report(FILE *out) const;
+private:
+	const char *name;
+	uint64_t total[PERF_EVENT_SIZE];
+	bool valid[PERF_EVENT_SIZE];
+	long long calls;
+	long long pixels;
+	std::mutex lock;
+};
+
+// Sample the counters of the enclosing scope (no-op when counters is NULL),
+// excluding the nested scopes of the same thread
+class PerfScope {
+public:
+	PerfScope(PerfCounters *counters, long long npixels);
+	~PerfScope();
+	// Counters of the innermost scope of the calling thread, NULL if none
+	static PerfCounters *current();
+private:
+	PerfCounters *counters;
+	long long npixels;
+	PerfCounters::Sample begin;
+	PerfScope *parent;
+};
+
+#endif
@@ -0,0 +1,169 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Staged execution of a comparison between two videos.
+
+ Frames go through three stages connected by bounded lock-free queues:
+ - read: read the frames of both videos (one thread, sequential I/O,
+   and the unpacking of the formats that are not planar 8-bit ones,
+   which costs a few milliseconds per 4K frame, less than the I/O),
+ - compute: compute the selected metrics (one MetricSet per thread),
+ - write: write the results in frame order (calling thread).
+ A fixed number of frame buffers circulates between the stages, so a
+ slow stage stalls the previous ones only once the queues in between
+ are full (backpressure) and memory use is bounded. The luma components
+ stay in their 8-bit samples, which the metrics widen as they need, in
+ buffers with aligned rows (see AlignedMat).
+
+ The frames are read in order, or in the order chosen by a FrameSampler,
+ seeking to each, until its estimates are precise enough: the frames
+ then in flight are dropped, so that the results do not depend on the
+ number of threads. The frames of a live source are read at its rate,
+ and the metrics of each frame are chosen by a LiveScheduler. The
+ sums of the metrics over blocks are copied out of the MetricSet by the
+ compute stage and written by the write stage (see BlockWriter), their
+ maps are quantized by the compute stage and compressed in the
+ background (see MapWriter). The weights of the pixels of each frame,
+ if any, are read with it (see WeightMask). With a FrameAligner, each
+ processed frame is compared with its matching original frame, and the
+ processed frames without one are skipped.
+
+ Statistics of queue occupancy and stage utilisation tell which stage
+ is the bottleneck, with the share of the time the read stage spent
+ unpacking rather than reading.
+
+**************************************************************************/
+
+#ifndef Pipeline_hpp
+#define Pipeline_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "BlockWriter.hpp"
+#include "BoundedQueue.hpp"
+#include "FrameAligner.hpp"
+#include "FrameSampler.hpp"
+#include "LiveScheduler.hpp"
+#include "MapWriter.hpp"
+#include "MetricSet.hpp"
+#include "ResultWriter.hpp"
+#include "VideoYUV.hpp"
+#include "WeightMask.hpp"
+
+enum PipelineStage {
+	STAGE_READ = 0,
+	STAGE_COMPUTE,
+	STAGE_WRITE,
+	STAGE_SIZE
+};
+
+class Pipeline {
+public:
+	Pipeline(VideoYUV *original, VideoYUV *processed, int nbframes);
+	~Pipeline();
+	// Set the capacity of the queue between stage and the next one
+	void setDepth(int stage, int depth);
+	// Start at a frame other than the first one, on which the videos have
+	// been positioned (see VideoYUV::seekFrame)
+	void setFirstFrame(int frame);
+	// Compare the frames drawn by sampler instead of all frames, until its
+	// estimates are within their tolerance
+	void setSampler(FrameSampler *sampler);
+	// Read the frames when they are due and compute the metrics planned by
+	// scheduler
+	void setScheduler(LiveScheduler *scheduler);
+	// Also compute the sums of the metrics over blocks and write their grids
+	// to block_writer
+	void setBlockWriter(BlockWriter *block_writer);
+	// Also keep the maps of the metrics and give them to map_writer
+	void setMapWriter(MapWriter *map_writer);
+	// Weight the pixels of each frame by the weights read from weight_mask
+	void setWeightMask(WeightMask *weight_mask);
+	// Compare each processed frame with the original frame matched by aligner
+	void setAligner(const FrameAligner *aligner);
+	// Run the pipeline, with one compute thread per MetricSet
+	// Return false if a frame could not be read
+	bool run(const std::vector<MetricSet*>& metrics, ResultWriter *writer);
+	// Print occupancy and utilisation statistics
+	void report(FILE *out) const;
+	// Mean and maximum time to compute the metrics of a frame, in seconds
+	double getMeanLatency() const;
+	double getMaxLatency() const;
+	// Number of frames whose results were written
+	int getFrames() const;
+private:
+	struct FrameSlot {
+		int frame;
+		int index;		// position in the order in which frames are read
+		cv::Mat luma[2];	// 8-bit luma of the original and processed frames
+		float result[METRIC_SIZE];
+		bool active[METRIC_SIZE];	// metrics computed, with a scheduler
+		std::vector<double> blocks;	// sums over blocks, with a block writer
+		cv::Mat weights;	// weights of the pixels and their bounds, with a weight mask
+		cv::Rect bounds;
+		double latency;
+	};
+	typedef BoundedQueue<FrameSlot*> SlotQueue;
+
+	void readStage();
+	void computeStage(MetricSet *metrics);
+	void writeStage(ResultWriter *writer);
+
+	VideoYUV *video[2];
+	int first_frame;
+	int nbframes;
+	FrameSampler *sampler;
+	LiveScheduler *scheduler;
+	BlockWriter *block_writer;
+	MapWriter *map_writer;
+	WeightMask *weight_mask;
+	const FrameAligner *aligner;
+	int depth[STAGE_SIZE-1];
+	int threads[STAGE_SIZE];
+
+	// queue[s] connects stage s to stage s+1, free returns slots to the read stage
+	SlotQueue *queue[STAGE_SIZE-1];
+	SlotQueue *free_slots;
+	std::vector<FrameSlot*> slots;
+	// Number of threads still running in each stage
+	std::atomic<int> running[STAGE_SIZE];
+	std::atomic<bool> read_failed;
+	// Set once the sampler does not need more frames
+	std::atomic<bool> stopped;
+
+	// Time spent processing frames in each stage, in nanoseconds
+	std::atomic<long long> busy_ns[STAGE_SIZE];
+	double wall_time;
+	// Time spent by the read stage unpacking the frames (see VideoYUV), in seconds
+	double unpack_time;
+	double latency_sum;
+	double latency_max;
+	int frames_done;
+};
+
+#endif
@@ -0,0 +1,93 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Pooling of per-frame scores in bounded memory.
+
+ Besides the minimum, maximum, mean and harmonic mean, quantiles (e.g.
+ the 1st or 5th percentile, which tell how bad the worst frames are) are
+ estimated with a quantile sketch of fixed capacity: scores are kept
+ exactly up to the capacity, then compacted level by level, each
+ compaction sorting a level and promoting every other score, with twice
+ the weight, to the next level (as in the KLL sketch). Lower levels keep
+ fewer scores than higher ones, so memory stays within about three times
+ the capacity whatever the number of frames (less than 100 kB per
+ metric with the default capacity), and the rank error of a quantile is
+ a small fraction of the number of frames (about 0.5% at most with the
+ default capacity, e.g. the 1st percentile of 2 million frames lies
+ between their 0.5th and 1.5th percentiles).
+
+ The compactions of a level alternate between keeping the even and the
+ odd scores instead of choosing at random, so results are reproducible.
+ Statistics gathered separately (by threads, or by jobs covering parts
+ of a video) can be merged, and saved to resume a run (see Checkpoint).
+
+**************************************************************************/
+
+#ifndef PooledStats_hpp
+#define PooledStats_hpp
+
+#include <string>
+#include <vector>
+#include "Reduction.hpp"
+
+class PooledStats {
+public:
+	PooledStats(int capacity = DEFAULT_CAPACITY);
+	void add(double x);
+	// Add the scores pooled by other
+	void merge(const PooledStats& other);
+	long long count() const;
+	double min() const;
+	double max() const;
+	double mean() const;
+	// Harmonic mean, 0 if a score is not positive
+	double harmonicMean() const;
+	// Score of rank q*(count()-1), interpolated between the two closest
+	// scores: exact as long as count() does not exceed the capacity
+	double quantile(double q) const;
+	// State as text, and back, return false if text is not valid
+	std::string save() const;
+	bool load(const std::string& text);
+
+	static const int DEFAULT_CAPACITY = 1024;
+private:
+	// Compact the levels that exceed their capacity
+	void compact();
+
+	int capacity;
+	long long n;
+	double min_value;
+	double max_value;
+	CompensatedSum sum;
+	CompensatedSum inverse_sum;
+	long long not_positive;
+	// Scores of level h stand for 2^h frames each
+	std::vector<std::vector<double> > levels;
+	// Number of compactions of each level, whose parity selects the scores kept
+	std::vector<unsigned int> compactions;
+};
+
+#endif
@@ -0,0 +1,87 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Image pyramids of MS-SSIM and VIFp.
+
+ Each level is built from the previous one by a single pass that filters
+ and subsamples 2:1 at once, into level buffers that are allocated on the
+ first frame and reused afterwards. Level 0 refers to the input image
+ (CV_8U or CV_32F) without copying it, so the image must stay valid
+ while the pyramid is used. The other levels are CV_32F, with aligned rows
+ (see AlignedMat).
+ - MS-SSIM: average of 2x2 blocks (same as cv::resize with INTER_LINEAR
+   for a factor of 2), 5 levels
+ - VIFp: Gaussian filtering of the 'valid' region with a window of
+   2^(4-l+1)+1 pixels for level l, then odd rows and columns dropped,
+   4 levels
+
+ Any size is supported, as in the Matlab implementations: a level keeps
+ the rows and columns 1:2:end of the filtered image, so it has ceil(n/2)
+ rows and columns for n filtered ones. For MS-SSIM, the 2x2 filter uses
+ symmetric padding, so an odd last row or column is averaged with itself.
+
+ A pyramid can be built once per frame and shared by several metrics.
+
+**************************************************************************/
+
+#ifndef Pyramid_hpp
+#define Pyramid_hpp
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+enum PyramidType {
+	PYRAMID_MSSSIM = 0,
+	PYRAMID_VIFP,
+	PYRAMID_SIZE
+};
+
+class Pyramid {
+public:
+	Pyramid(PyramidType type);
+	// Build all the levels of image
+	void build(const cv::Mat& image);
+	// Number of levels, including level 0
+	int getLevels() const;
+	// Level l, build() needs to be called before getLevel()
+	const cv::Mat& getLevel(int l) const;
+	static const int MSSSIM_LEVELS = 5;
+	static const int VIFP_LEVELS = 4;
+	// Size of the Gaussian window of each level of a VIFp pyramid
+	static const int VIFP_WINDOW[VIFP_LEVELS];
+	// Number of rows (or columns) of level l for size rows (or columns) at level 0
+	int getLevelSize(int size, int l) const;
+	// Minimum height and width of the images, so that each level is at least
+	// as large as the window of the metric at that level
+	int getMinSize() const;
+private:
+	PyramidType type;
+	std::vector<cv::Mat> levels;
+	// Compute the rows [begin, end) of level l from level l-1
+	void downsample(int l, int begin, int end);
+};
+
+#endif
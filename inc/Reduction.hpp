@@ -0,0 +1,93 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Deterministic reductions used by all metrics.
+
+ Matrices are reduced row by row: each row is summed in double precision
+ in a fixed order, and the row partials are then combined pairwise, also
+ in a fixed order. The result therefore only depends on the data, not on
+ how the rows are distributed among threads or grouped into tiles, and is
+ bit-identical whatever the number of threads.
+
+ CompensatedSum is a Neumaier (improved Kahan) accumulator for long
+ streams of values, such as per-frame scores.
+
+**************************************************************************/
+
+#ifndef Reduction_hpp
+#define Reduction_hpp
+
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+class Reduction {
+public:
+	// Sum of the n elements of a row, in a fixed order
+	static double sumRow(const float *row, int n);
+	// Pairwise sum of n partial values, in a fixed order
+	static double pairwise(const double *partial, int n);
+	static double pairwise(const std::vector<double>& partial);
+	// Sum of all elements of a single-channel CV_32F matrix
+	static double sum(const cv::Mat& m);
+	// Mean of all elements of a single-channel CV_32F matrix
+	static double mean(const cv::Mat& m);
+};
+
+class CompensatedSum {
+public:
+	CompensatedSum() : sum(0.0), comp(0.0) {}
+	// Accumulator restored from the state returned by getSum() and getCompensation()
+	CompensatedSum(double s, double c) : sum(s), comp(c) {}
+	void add(double x)
+	{
+		double t = sum + x;
+		if (std::fabs(sum) >= std::fabs(x)) {
+			comp += (sum - t) + x;
+		}
+		else {
+			comp += (x - t) + sum;
+		}
+		sum = t;
+	}
+	double value() const
+	{
+		return sum + comp;
+	}
+	double getSum() const
+	{
+		return sum;
+	}
+	double getCompensation() const
+	{
+		return comp;
+	}
+private:
+	double sum;
+	double comp;
+};
+
+#endif
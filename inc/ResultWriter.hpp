@@ -0,0 +1,113 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Output of the per-frame results to one CSV file per metric, or to the
+ stream of a client of the server (see Server), and of the statistics of
+ each metric over all frames to a summary file (see PooledStats).
+
+ Long runs can be checkpointed every few frames: the output files are
+ flushed to disk, then their sizes and the running sums of the averages
+ are saved, with the next frame to read, in a checkpoint file
+ (replaced atomically). An interrupted run resumes from the last
+ checkpoint by truncating the output files to the saved sizes and
+ restoring the sums, and loses at most one checkpoint interval.
+
+**************************************************************************/
+
+#ifndef ResultWriter_hpp
+#define ResultWriter_hpp
+
+#include <stdio.h>
+#include <string>
+#include "MetricSet.hpp"
+#include "PooledStats.hpp"
+#include "Reduction.hpp"
+
+// State of the output files of a job after some frames
+struct Checkpoint {
+	std::string job;		// arguments of the job
+	int frame;			// next frame to read, -1 if there is no checkpoint
+	long offset[METRIC_SIZE];	// size of the output file of each metric
+	double sum[METRIC_SIZE];	// running sum of each metric (see CompensatedSum)
+	double compensation[METRIC_SIZE];
+	std::string stats[METRIC_SIZE];	// pooled statistics (see PooledStats::save)
+	// Read the checkpoint saved at path, if any
+	// Print the error and return false if it is not valid
+	bool load(const std::string& path);
+};
+
+class ResultWriter {
+public:
+	// Open the file <prefix>_<metric>.csv of each selected metric
+	// echo: also print the results of each frame on the standard output
+	// resume: continue the files of an interrupted run, NULL to start anew
+	ResultWriter(const char *prefix, const bool selected[METRIC_SIZE], bool echo = true, const Checkpoint *resume = NULL);
+	// Write the results of each frame to stream instead, as a line
+	// "frame <frame> <value>..." with the values of the selected metrics in
+	// the order of Metrics, exact when read back as floats
+	ResultWriter(FILE *stream, const bool selected[METRIC_SIZE]);
+	~ResultWriter();
+	// Whether all the files could be opened (and resumed), the error has
+	// been printed otherwise
+	bool isOpen() const;
+	// Write the results of one frame, frames have to be written in order
+	// computed: metrics computed for this frame, NULL for all selected ones
+	// A NaN result (no score, see WeightMask) is written as nan and left out
+	// of the average and statistics
+	void write(int frame, const float result[METRIC_SIZE], const bool *computed = NULL);
+	// Save a checkpoint at path every interval frames written (0: never),
+	// for the given job. The checkpoint is removed once the averages have been written
+	void setCheckpoint(const std::string& path, int interval, const std::string& job);
+	// Also write the pooled statistics of each metric to <prefix>_summary.csv
+	// when closing the files
+	void setSummary(bool enable);
+	// Add the statistics of the frames written to stats, for each selected metric
+	void mergeStats(PooledStats stats[METRIC_SIZE]) const;
+	// Write the statistics of the selected metrics to a summary file: number
+	// of frames, mean, harmonic mean, minimum, 1st, 5th and 50th percentiles
+	// and maximum
+	static void writeSummary(const std::string& path, const PooledStats stats[METRIC_SIZE], const bool selected[METRIC_SIZE]);
+	// Write the average of each metric over the frames written and close the files
+	void close();
+private:
+	std::string prefix;
+	FILE *result_file[METRIC_SIZE];
+	CompensatedSum result_avg[METRIC_SIZE];
+	PooledStats result_stats[METRIC_SIZE];
+	bool summary;
+	bool echo;
+	FILE *stream;
+	bool selected[METRIC_SIZE];
+	bool opened;
+
+	void saveCheckpoint(int frame);
+	std::string checkpoint_path;
+	std::string checkpoint_job;
+	int checkpoint_interval;
+	int checkpoint_frames;	// frames written since the last checkpoint
+};
+
+#endif
@@ -0,0 +1,116 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Long-running server comparing videos for local clients (POSIX only).
+
+ The server listens on a Unix domain socket and keeps the metric
+ instances of the last jobs once they have ended, so that the jobs of
+ interactive tools do not pay the start of a process and the allocation
+ of the metrics each time. At most IDLE_JOBS jobs' worth of instances are
+ kept, the least recently used being deleted first, so that a server
+ seeing many resolutions does not keep them all. Each client connection is served
+ by its own thread, and the frames of all connections are computed by
+ the shared work-stealing thread pool.
+
+ Protocol (one line per message, see Job for the quoting of arguments):
+ - the client sends the arguments of a job, as on the command line
+   (OriginalVideo ... Metrics, with --stride=N and --ssim-fixed if
+   needed), and may send more jobs once the previous one has ended
+ - the server answers "frame <frame> <value>..." for each frame in
+   order, with the values of the selected metrics in the order of
+   Metrics (see ResultWriter), then "end", or "error <message>"
+ Paths are opened by the server, relative to its working directory. A
+ video given as shm:<name> is read from the POSIX shared memory object
+ <name> (see shm_open), which holds the frames laid out as in a file.
+
+ Client sends a job and writes its results like the command line, so
+ "vqmt --connect=<socket> <arguments>" can replace "vqmt <arguments>".
+
+**************************************************************************/
+
+#ifndef Server_hpp
+#define Server_hpp
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Job.hpp"
+#include "PerfCounters.hpp"
+#include "Pipeline.hpp"
+
+class Server {
+public:
+	// Listen on the socket at path, exit if it cannot be created
+	// compute_threads, depth and perf are used for every job, as in Batch
+	Server(const char *path, int compute_threads, const int depth[STAGE_SIZE-1], PerfCounters *const *perf);
+	~Server();
+	// Serve clients until the process is terminated
+	void run();
+private:
+	Server(const Server&);
+	Server& operator=(const Server&);
+	// Run the jobs sent on a connection until it is closed
+	void serve(int fd);
+	// Run a job, streaming its results to out
+	// Return false and set error if it failed
+	bool runJob(const Job& job, FILE *out, std::string& error);
+	// Metric instances for a job, created if none is idle
+	MetricSet *acquire(const Job& job);
+	// Keep the instances of a job idle, deleting the least recently used
+	// ones beyond IDLE_JOBS*compute_threads
+	void release(const Job& job, MetricSet *metrics);
+
+	std::string path;
+	int listen_fd;
+	int compute_threads;
+	int depth[STAGE_SIZE-1];
+	PerfCounters *const *perf;
+
+	// Idle metric instances with their resolution and selection of metrics,
+	// from the least to the most recently used
+	std::mutex idle_lock;
+	std::list<std::pair<std::string, MetricSet*> > idle;
+	static const int IDLE_JOBS = 4;
+};
+
+class Client {
+public:
+	// Connect to the server listening on the socket at path, exit on failure
+	Client(const char *path);
+	~Client();
+	// Run a job on the server and write its results as the command line does
+	// Return false if it failed
+	bool run(const Job& job);
+private:
+	Client(const Client&);
+	Client& operator=(const Client&);
+
+	int fd;
+	FILE *in;
+};
+
+#endif
@@ -0,0 +1,69 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Graph of tasks with dependencies executed on the shared thread pool.
+
+ A task is submitted to the pool as soon as all the tasks it depends on
+ have completed, so independent tasks (e.g. the metrics of a frame and
+ the reading of the next frame) run concurrently.
+
+**************************************************************************/
+
+#ifndef TaskGraph_hpp
+#define TaskGraph_hpp
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "ThreadPool.hpp"
+
+class TaskGraph {
+public:
+	TaskGraph(ThreadPool& pool);
+	~TaskGraph();
+	// Add a task that runs once the tasks in deps have completed
+	// Return the identifier of the task
+	int add(const std::function<void()>& fn, const std::vector<int>& deps = std::vector<int>());
+	// Run all tasks and return once they have completed
+	// The graph may be run again afterwards
+	void run();
+private:
+	struct Node {
+		std::function<void()> fn;
+		std::vector<int> successors;
+		int ndeps;
+		std::atomic<int> pending;
+	};
+	TaskGraph(const TaskGraph&);
+	TaskGraph& operator=(const TaskGraph&);
+	void schedule(int id);
+
+	ThreadPool& pool;
+	std::vector<Node*> nodes;
+	std::atomic<int> remaining;
+};
+
+#endif
@@ -0,0 +1,91 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Work-stealing thread pool shared by all metrics.
+
+ Each worker owns a deque of tasks: it pops its own tasks from the back
+ and steals from the front of the other deques when it runs out of work.
+ Tasks submitted from threads that are not workers go to a shared
+ injection deque. A thread waiting for a parallelFor() to complete keeps
+ executing pending tasks, so parallel loops can be nested (e.g. a loop
+ over scales whose iterations run a loop over row bands).
+
+**************************************************************************/
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	// Pool shared by all metrics, created on first use
+	static ThreadPool& instance();
+	// Set the number of threads of the shared pool, including the calling thread
+	// Has to be called before the first call to instance()
+	static void setNumThreads(int n);
+	// Return the number of threads, including the calling thread
+	int getNumThreads() const;
+	// Call body(begin, end) on consecutive ranges of at most grain indexes
+	// covering [0, n), and return once all of them have completed
+	void parallelFor(int n, int grain, const std::function<void(int,int)>& body);
+	// Queue a task for asynchronous execution
+	void submit(const std::function<void()>& task);
+	// Execute one pending task, if any, on the calling thread
+	// Return false if no task was found
+	bool runPendingTask();
+	~ThreadPool();
+private:
+	struct Queue {
+		std::deque<std::function<void()> > tasks;
+		std::mutex lock;
+	};
+	ThreadPool(int nthreads);
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+	void workerLoop(int index);
+	bool pop(int index, std::function<void()>& task);
+	bool steal(int index, std::function<void()>& task);
+
+	int nthreads;
+	std::vector<std::thread> workers;
+	// One queue per worker, plus the injection queue
+	std::vector<Queue*> queues;
+	std::atomic<int> queued;
+	std::atomic<bool> stopping;
+	std::mutex sleep_lock;
+	std::condition_variable wakeup;
+
+	static int requested_threads;
+};
+
+#endif
@@ -56,17 +56,37 @@
 #define VIFP_hpp
 
 #include "Metric.hpp"
+#include "Pyramid.hpp"
 
 class VIFP : protected Metric {
 public:
 	VIFP(int height, int width);
 	// Compute the VIFp index of the processed image
 	float compute(const cv::Mat& original, const cv::Mat& processed);
+	// Same as compute, from VIFp pyramids that have already been built
+	float compute(const Pyramid& original, const Pyramid& processed);
+	// Also keep the map of the finest scale of the next images: the ratio of
+	// the numerator and denominator terms (1 where the original image has no
+	// information), of (height-16) x (width-16) elements, element (i, j) for
+	// the window centred on pixel (i+8, j+8)
+	void setMapEnabled(bool enable);
+	// Map of the last images (see setMapEnabled)
+	cv::Mat getMap() const;
 private:
-	static const int NLEVS = 4;
+	// Pyramids of the images given to compute()
+	Pyramid original_pyramid;
+	Pyramid processed_pyramid;
+	static const int NLEVS = Pyramid::VIFP_LEVELS;
 	static const float SIGMA_NSQ;
-	// Compute the coefficients of the VIFp index at a particular subband
-	void computeVIFP(const cv::Mat& ref, const cv::Mat& dist, int N, double& num, double& den);
+	bool map_enabled;
+	cv::Mat vifp_map;
+	// Compute the coefficients of the VIFp index at a particular subband,
+	// and its map if map is not NULL
+	void computeVIFP(const cv::Mat& ref, const cv::Mat& dist, int N, double& num, double& den, cv::Mat *map);
+	// Compute the rows [begin, end) of the numerator and denominator maps
+	// and store the sum of each row in num_rows and den_rows, and their
+	// ratio in map if not NULL
+	void computeVIFPBand(const cv::Mat& ref, const cv::Mat& dist, int N, int begin, int end, double *num_rows, double *den_rows, cv::Mat *map);
 };
 
 #endif
@@ -59,29 +59,77 @@ enum ChromaSubsampling {
 	CHROMA_SUBSAMP_444 = 3
 };
 
+// Packed and semi-planar formats, unpacked into 8-bit planes when read
+enum PackedFormat {
+	FORMAT_NV12 = 4,	// Y plane, then interleaved U and V plane at 4:2:0
+	FORMAT_P010 = 5,	// same as NV12 with 16-bit little-endian samples (10 bits in the MSBs)
+	FORMAT_UYVY = 6,	// packed 4:2:2, U Y0 V Y1
+	FORMAT_YUYV = 7		// packed 4:2:2, Y0 U Y1 V
+};
+
 class VideoYUV {
 public:
-	VideoYUV(const char *file, int height, int width, int nbframes, int chroma_format);
+	// chroma_format: one of ChromaSubsampling or PackedFormat
+	// stride: number of bytes between the starts of two rows of luma in the
+	// file, for rows padded by hardware decoders (0: rows are not padded).
+	// Chroma rows are padded in proportion (stride/2 for YUV420 and YUV422)
+	VideoYUV(const char *file, int height, int width, int nbframes, int chroma_format, int stride = 0);
+	// Frames laid out as in a file in size bytes of memory (e.g. mapped shared
+	// memory), which has to stay valid until the VideoYUV is destroyed
+	VideoYUV(const imgpel *data, size_t size, int height, int width, int nbframes, int chroma_format, int stride = 0);
 	~VideoYUV();
+	// Whether the file could be opened (the error has been printed otherwise)
+	bool isOpen() const;
+	// Check that the geometry is supported by the format of the file
+	// Print the error and return false otherwise
+	static bool check(int height, int width, int chroma_format, int stride);
 	// Read one frame
 	bool readOneFrame();
-	// Get the luma component
-	// readOneFrame() needs to be called before getLuma()
+	// Position the video on a frame, the next frame read being that one
+	// Return false if the file cannot be positioned there
+	bool seekFrame(int frame);
+	// Unpack one frame from memory, laid out as in the file (getFrameSize()
+	// bytes, padded rows included). Planar samples are not copied: src has
+	// to stay valid until getLuma() has been called
+	void loadFrame(const imgpel *src);
+	// Read row y of the luma of a frame alone, as width 8-bit samples, into
+	// dst. The frame last read is overwritten and the position of the video
+	// is undefined afterwards (see seekFrame)
+	// Return false if the row cannot be read
+	bool readLumaRow(int frame, int y, imgpel *dst);
+	// Number of bytes of one frame in the file
+	int getFrameSize() const;
+	// Time spent unpacking the samples that are not planar 8-bit ones
+	// (loadFrame), in seconds
+	double getUnpackTime() const;
+	// Get the luma component, in a matrix with aligned rows (see AlignedMat)
+	// for CV_8UC1. readOneFrame() or loadFrame() needs to be called before
+	// getLuma()
 	void getLuma(cv::Mat& luma, int type = CV_8UC1);
 private:
 	int file;		// file stream
+	const imgpel *memory;	// frames in memory instead of a file, NULL otherwise
+	size_t memory_size;	// number of bytes in memory
+	size_t memory_pos;	// offset of the next frame in memory
+	int format;		// format of the file
 	int nbframes;		// number of frames
 	int height;		// height
 	int width;		// width
 	int comp_height[3];	// height in specific component
 	int comp_width[3];	// width in specific component
 
-	int size;		// number of samples
-	int comp_size[3];	// number of samples in specific component
+	int comp_stride[3];	// bytes between rows of a specific component in the file
+	int comp_offset[3];	// offset of a specific component in a frame of the file
+	int frame_size;		// number of bytes of a frame in the file
+
+	cv::Mat buffer;		// frame as read from the file
+	cv::Mat plane[3];	// 8-bit components, views of the frame read for planar samples
+	long long unpack_ns;	// time spent unpacking, in nanoseconds
 
-	imgpel *data;		// data array
-	imgpel *luma;		// pointer to luma
-	imgpel *chroma[2];	// pointers to chroma
+	// Set the geometry of the frames and allocate the buffers
+	void init(int height, int width, int nbframes, int chroma_format, int stride);
+	// Read size bytes, return false at the end of the file
+	bool readBytes(imgpel *buf, int size);
 };
 
 #endif
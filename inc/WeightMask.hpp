@@ -0,0 +1,106 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+/**************************************************************************
+
+ Weights of the pixels of each frame, for metrics restricted to regions
+ of interest (see MetricSet::setWeights).
+
+ The weights are read from either:
+ - a mask video: one plane of height x width 8-bit samples per frame (a
+   YUV 4:0:0 file), the weight of a pixel being its sample divided by
+   255. A mask of a single frame applies to all frames,
+ - a text file of rectangles, one per line:
+     Frame X Y Width Height Weight
+   where Frame is a frame number or * for all frames, and Weight is a
+   non-negative real number. The pixels out of all rectangles have a
+   weight of 0. The rectangles for all frames are drawn first, then those
+   of the frame, each in the order of the file, a rectangle replacing the
+   weights of the previous ones. The rectangles are cut by the borders of
+   the frame. Empty lines and lines starting with # are ignored.
+ The weights are relative: the metrics divide their weighted sums by the
+ sum of the weights. Zero weights exclude pixels (e.g. letterbox bars or a
+ logo), larger weights emphasize regions (e.g. faces). A frame whose
+ weights are all zero has no score: the weighted metrics return NaN, and
+ the frame is written as nan and left out of the averages (see
+ ResultWriter).
+
+ The rectangle out of which all weights are zero is returned with the
+ weights of each frame, so that the metrics skip the excluded rows and
+ columns. The weights of the frames without rectangles of their own, and
+ those of a mask of a single frame, are computed once and shared.
+
+**************************************************************************/
+
+#ifndef WeightMask_hpp
+#define WeightMask_hpp
+
+#include <map>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "VideoYUV.hpp"
+
+class WeightMask {
+public:
+	// Weights from a mask video of nbframes frames, or of a single frame
+	// Print the error and return NULL if the file cannot be read
+	static WeightMask *openVideo(const char *file, int height, int width, int nbframes);
+	// Weights from a file of rectangles
+	// Print the error and return NULL if the file cannot be read or is not valid
+	static WeightMask *openRectangles(const char *file, int height, int width);
+	~WeightMask();
+	// Weights of a frame (CV_32F, with aligned rows), and the smallest
+	// rectangle out of which they are all zero (empty if they all are)
+	// Return false if the frame cannot be read
+	bool read(int frame, cv::Mat& weights, cv::Rect& bounds);
+private:
+	WeightMask(int height, int width);
+	WeightMask(const WeightMask&);
+	WeightMask& operator=(const WeightMask&);
+
+	struct Region {
+		cv::Rect rect;
+		float weight;
+	};
+	// Fill weights with zeros and draw regions on them
+	void draw(cv::Mat& weights, const std::vector<Region> *regions, int count) const;
+	// Smallest rectangle out of which weights are zero
+	static cv::Rect nonZeroBounds(const cv::Mat& weights);
+
+	int height;
+	int width;
+	// Mask video, NULL for rectangles
+	VideoYUV *video;
+	int video_frames;
+	int next_frame;		// frame the video is positioned on
+	cv::Mat luma;
+	// Rectangles for all frames, and for each frame that has some
+	std::vector<Region> all_regions;
+	std::map<int, std::vector<Region> > frame_regions;
+	// Weights shared by several frames, empty until computed
+	cv::Mat shared;
+	cv::Rect shared_bounds;
+};
+
+#endif
@@ -0,0 +1,152 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <utility>
+#include "AlignedMat.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif /* __linux__ */
+
+const size_t AlignedMat::HUGE_PAGE_SIZE;
+bool AlignedMat::huge_pages = false;
+
+// Scratch buffer of a thread: aligned bytes, viewed with the shape of the
+// last request, and the huge page setting it was created with
+struct ScratchBuffer {
+	ScratchBuffer() : rows(0), cols(0), type(-1), huge_pages(false) {}
+	cv::Mat buffer;
+	int rows;
+	int cols;
+	int type;
+	bool huge_pages;
+};
+
+bool AlignedMat::setHugePages(bool enable)
+{
+	huge_pages = false;
+	if (!enable) {
+		return true;
+	}
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// Available unless disabled system-wide ("never")
+	FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (f == NULL) {
+		return false;
+	}
+	char mode[128];
+	huge_pages = fgets(mode, sizeof(mode), f) != NULL && strstr(mode, "[never]") == NULL;
+	fclose(f);
+#endif /* __linux__ && MADV_HUGEPAGE */
+	return huge_pages;
+}
+
+bool AlignedMat::isAligned(const cv::Mat& m)
+{
+	// Same stride as in create()
+	size_t alignment = static_cast<size_t>(ALIGNMENT);
+	size_t row_bytes = static_cast<size_t>(m.cols)*m.elemSize();
+	return m.data != NULL && reinterpret_cast<uintptr_t>(m.data) % alignment == 0
+		&& m.step[0] == (row_bytes + alignment - 1) / alignment * alignment + alignment;
+}
+
+void AlignedMat::create(cv::Mat& m, int rows, int cols, int type)
+{
+	if (m.rows == rows && m.cols == cols && m.type() == type && isAligned(m)) {
+		return;
+	}
+	CV_Assert(rows > 0 && cols > 0);
+
+	// Rows padded to a multiple of 64 bytes, plus 64 bytes to align the start
+	size_t row_alignment = static_cast<size_t>(ALIGNMENT);
+	size_t elem_size = static_cast<size_t>(CV_ELEM_SIZE(type));
+	size_t step = (static_cast<size_t>(cols)*elem_size + row_alignment - 1) / row_alignment * row_alignment + row_alignment;
+	size_t bytes = step*static_cast<size_t>(rows);
+	bool huge = huge_pages && bytes >= HUGE_PAGE_SIZE;
+	size_t alignment = huge ? HUGE_PAGE_SIZE : row_alignment;
+
+	// A single row with room to move the start to the next boundary, so
+	// that the views taken from it keep it alive
+	cv::Mat buffer(1, static_cast<int>((bytes + alignment)/elem_size), type);
+	uintptr_t misalignment = reinterpret_cast<uintptr_t>(buffer.data) % alignment;
+	size_t offset = misalignment > 0 ? alignment - misalignment : 0;
+	CV_Assert(offset % elem_size == 0);
+	int x = static_cast<int>(offset/elem_size);
+	cv::Mat aligned = buffer.colRange(x, x + static_cast<int>(bytes/elem_size));
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// Advised before the pages are touched, so that they are faulted in as
+	// huge pages (errors only mean ordinary pages)
+	if (huge) {
+		madvise(aligned.data, bytes, MADV_HUGEPAGE);
+	}
+#endif /* __linux__ && MADV_HUGEPAGE */
+	aligned.setTo(cv::Scalar(0));
+
+	m = aligned.reshape(0, rows).colRange(0, cols);
+}
+
+cv::Mat AlignedMat::scratch(int id, int rows, int cols, int type)
+{
+	static thread_local std::map<int, ScratchBuffer> buffers;
+
+	// Same stride as in create()
+	size_t alignment = static_cast<size_t>(ALIGNMENT);
+	size_t row_bytes = static_cast<size_t>(cols)*static_cast<size_t>(CV_ELEM_SIZE(type));
+	size_t step = (row_bytes + alignment - 1) / alignment * alignment + alignment;
+	size_t bytes = step*static_cast<size_t>(rows);
+
+	ScratchBuffer& scratch_buffer = buffers[id];
+	if (static_cast<size_t>(scratch_buffer.buffer.cols) < bytes || scratch_buffer.huge_pages != huge_pages) {
+		// Released first so that the memory can be reused
+		scratch_buffer.buffer.release();
+		create(scratch_buffer.buffer, 1, static_cast<int>(bytes), CV_8U);
+		scratch_buffer.huge_pages = huge_pages;
+		scratch_buffer.type = -1;
+	}
+	cv::Mat m(rows, cols, type, scratch_buffer.buffer.data, step);
+	if (scratch_buffer.rows < rows || scratch_buffer.cols != cols || scratch_buffer.type != type) {
+		// The padding of the rows moved: zeroed again
+		for (int y=0; y<rows; y++) {
+			memset(m.ptr(y) + row_bytes, 0, step - row_bytes);
+		}
+		scratch_buffer.rows = rows;
+		scratch_buffer.cols = cols;
+		scratch_buffer.type = type;
+	}
+	return m;
+}
+
+int AlignedMat::paddedCols(const cv::Mat& m, int n)
+{
+	if (!isAligned(m)) {
+		return n;
+	}
+	int elems = ALIGNMENT / static_cast<int>(m.elemSize());
+	return (n + elems - 1) / elems * elems;
+}
@@ -0,0 +1,216 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <opencv2/core/core.hpp>
+#include "Batch.hpp"
+#include "FrameSampler.hpp"
+#include "LiveScheduler.hpp"
+#include "ResultWriter.hpp"
+#include "VideoYUV.hpp"
+
+Batch::Batch(const char *m)
+{
+	manifest = m;
+	std::ifstream in(m);
+	if (!in) {
+		fprintf(stderr, "Cannot open manifest %s\n", m);
+		exit(EXIT_FAILURE);
+	}
+
+	std::string line;
+	for (int line_no=1; std::getline(in, line); line_no++) {
+		std::vector<std::string> args;
+		bool ok = Job::split(line, args);
+		if (ok && (args.empty() || args[0][0] == '#')) continue;
+
+		Job job;
+		ok = ok && job.parse(args);
+		if (ok && !job.options.empty()) {
+			fprintf(stderr, "Option %s applies to the whole batch.\n", job.options[0].c_str());
+			ok = false;
+		}
+		if (!ok) {
+			fprintf(stderr, "%s:%d: invalid job.\n", m, line_no);
+			exit(EXIT_FAILURE);
+		}
+		jobs.push_back(job);
+	}
+
+	for (size_t j=0; j<jobs.size(); j++) {
+		order.push_back(j);
+	}
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+		return jobs[a].getCost() > jobs[b].getCost();
+	});
+
+	next = 0;
+	done = 0;
+	failed = 0;
+	frames = 0;
+	compute_threads = 1;
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		depth[s] = 0;
+	}
+	perf = NULL;
+	for (int i=0; i<METRIC_SIZE; i++) {
+		pooled_selected[i] = false;
+	}
+}
+
+int Batch::run(int njobs, int ct, const int d[STAGE_SIZE-1], PerfCounters *const *p)
+{
+	compute_threads = ct > 0 ? ct : 1;
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		depth[s] = d[s];
+	}
+	perf = p;
+
+	// The calling thread runs jobs too
+	std::vector<std::thread> runners;
+	for (int t=1; t<njobs && static_cast<size_t>(t)<jobs.size(); t++) {
+		runners.push_back(std::thread(&Batch::runJobs, this));
+	}
+	runJobs();
+	for (size_t t=0; t<runners.size(); t++) {
+		runners[t].join();
+	}
+
+	bool pooled_any = false;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		pooled_any = pooled_any || pooled_selected[m];
+	}
+	if (pooled_any) {
+		ResultWriter::writeSummary(manifest + "_summary.csv", pooled, pooled_selected);
+	}
+	return failed;
+}
+
+int Batch::size() const
+{
+	return static_cast<int>(jobs.size());
+}
+
+long long Batch::getFrames() const
+{
+	return frames;
+}
+
+void Batch::runJobs()
+{
+	for (size_t i=next++; i<order.size(); i=next++) {
+		const Job& job = jobs[order[i]];
+		double duration = static_cast<double>(cv::getTickCount());
+		int compared;
+		bool ok = runJob(job, compared);
+		duration = (static_cast<double>(cv::getTickCount())-duration) / cv::getTickFrequency();
+
+		if (ok) {
+			frames += compared;
+		}
+		else {
+			failed++;
+		}
+		printf("[%d/%d] %s: %s, %d frames, %0.3fs\n", ++done, size(), job.output.c_str(), ok ? "done" : "failed", compared, duration);
+		fflush(stdout);
+	}
+}
+
+bool Batch::runJob(const Job& job, int& compared)
+{
+	compared = 0;
+	// Files that cannot be opened fail the job only
+	VideoYUV *original  = new VideoYUV(job.original.c_str(), job.height, job.width, job.nbframes, job.chroma, job.stride);
+	VideoYUV *processed = new VideoYUV(job.processed.c_str(), job.height, job.width, job.nbframes, job.chroma, job.stride);
+	int first_frame = 0;
+	ResultWriter *writer = original->isOpen() && processed->isOpen() ? job.createWriter(job.output, false, first_frame) : NULL;
+	if (writer == NULL || !original->seekFrame(first_frame) || !processed->seekFrame(first_frame)) {
+		delete writer;
+		delete original;
+		delete processed;
+		return false;
+	}
+
+	std::vector<MetricSet*> metrics;
+	for (int t=0; t<compute_threads; t++) {
+		metrics.push_back(new MetricSet(job.height, job.width, job.selected, job.ssim_fixed, job.original.c_str(), perf));
+	}
+
+	Pipeline *pipeline = new Pipeline(original, processed, job.nbframes);
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		if (depth[s] > 0) pipeline->setDepth(s, depth[s]);
+	}
+	pipeline->setFirstFrame(first_frame);
+	FrameSampler *sampler = NULL;
+	if (job.sample > 0.0) {
+		sampler = new FrameSampler(job.nbframes, job.selected, job.sample);
+		pipeline->setSampler(sampler);
+	}
+	LiveScheduler *scheduler = job.createScheduler(job.output);
+	if (scheduler != NULL) pipeline->setScheduler(scheduler);
+	BlockWriter *block_writer = job.createBlockWriter(job.output);
+	if (block_writer != NULL) pipeline->setBlockWriter(block_writer);
+	MapWriter *map_writer = job.createMapWriter(job.output);
+	if (map_writer != NULL) pipeline->setMapWriter(map_writer);
+	WeightMask *weight_mask = NULL;
+	bool ok = job.createWeightMask(weight_mask);
+	if (weight_mask != NULL) pipeline->setWeightMask(weight_mask);
+	FrameAligner *aligner = job.createAligner();
+	if (ok && aligner != NULL) {
+		ok = aligner->align(original, processed, job.nbframes) && aligner->save(job.output + "_align.csv");
+		pipeline->setAligner(aligner);
+	}
+	ok = ok && pipeline->run(metrics, writer);
+	compared = pipeline->getFrames();
+
+	// Print average quality index to file, only if all frames were compared
+	if (ok) writer->close();
+	if (ok && job.summary) {
+		std::lock_guard<std::mutex> guard(pooled_lock);
+		writer->mergeStats(pooled);
+		for (int m=0; m<METRIC_SIZE; m++) {
+			pooled_selected[m] = pooled_selected[m] || job.selected[m];
+		}
+	}
+
+	delete sampler;
+	delete scheduler;
+	delete block_writer;
+	delete map_writer;
+	delete weight_mask;
+	delete aligner;
+	delete pipeline;
+	for (size_t t=0; t<metrics.size(); t++) {
+		delete metrics[t];
+	}
+	delete writer;
+	delete original;
+	delete processed;
+	return ok;
+}
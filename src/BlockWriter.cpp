@@ -0,0 +1,175 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "BlockWriter.hpp"
+
+static const char MAGIC[8] = {'V', 'Q', 'M', 'T', 'G', 'R', 'I', 'D'};
+static const unsigned int VERSION = 1;
+
+static int gcd(int a, int b)
+{
+	return b == 0 ? a : gcd(b, a % b);
+}
+
+// Number of elements of [begin, end) within [low, high)
+static int overlap(int begin, int end, int low, int high)
+{
+	return std::max(0, std::min(end, high) - std::max(begin, low));
+}
+
+static void putU32(std::vector<unsigned char>& buffer, unsigned int value)
+{
+	for (int b=0; b<4; b++) {
+		buffer.push_back(static_cast<unsigned char>(value >> (8*b)));
+	}
+}
+
+static void putFloat(std::vector<unsigned char>& buffer, float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	putU32(buffer, bits);
+}
+
+BlockWriter::BlockWriter(const std::string& prefix, int height, int width, const std::vector<int>& sizes, const bool selected[METRIC_SIZE])
+{
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (selected[m] && METRIC_BLOCKS[m]) {
+			metrics.push_back(m);
+		}
+	}
+	base_size = 0;
+	for (size_t s=0; s<sizes.size(); s++) {
+		base_size = gcd(sizes[s], base_size);
+	}
+	base_cols = (width + base_size - 1) / base_size;
+	base_rows = (height + base_size - 1) / base_size;
+
+	for (size_t s=0; s<sizes.size(); s++) {
+		Grid grid;
+		grid.size = sizes[s];
+		grid.cols = (width + grid.size - 1) / grid.size;
+		grid.rows = (height + grid.size - 1) / grid.size;
+		size_t nblocks = static_cast<size_t>(grid.rows*grid.cols);
+		grid.pixels.assign(nblocks, 0.0);
+		grid.windows.assign(nblocks, 0.0);
+		for (int r=0; r<base_rows; r++) {
+			for (int c=0; c<base_cols; c++) {
+				int y = r*base_size, x = c*base_size;
+				int b = (y/grid.size)*grid.cols + x/grid.size;
+				grid.block.push_back(b);
+				// The SSIM windows are centred on [5, height-5) x [5, width-5)
+				grid.pixels[static_cast<size_t>(b)] += static_cast<double>(overlap(y, y+base_size, 0, height))*overlap(x, x+base_size, 0, width);
+				grid.windows[static_cast<size_t>(b)] += static_cast<double>(overlap(y, y+base_size, 5, height-5))*overlap(x, x+base_size, 5, width-5);
+			}
+		}
+
+		std::string path = prefix + "_blocks" + std::to_string(grid.size) + ".bin";
+		grid.file = fopen(path.c_str(), "wb");
+		if (grid.file == NULL) {
+			fprintf(stderr, "Cannot open output file %s\n", path.c_str());
+		}
+		else {
+			std::vector<unsigned char> header(MAGIC, MAGIC+sizeof(MAGIC));
+			putU32(header, VERSION);
+			putU32(header, static_cast<unsigned int>(width));
+			putU32(header, static_cast<unsigned int>(height));
+			putU32(header, static_cast<unsigned int>(grid.size));
+			putU32(header, static_cast<unsigned int>(grid.cols));
+			putU32(header, static_cast<unsigned int>(grid.rows));
+			putU32(header, static_cast<unsigned int>(metrics.size()));
+			for (size_t m=0; m<metrics.size(); m++) {
+				putU32(header, static_cast<unsigned int>(metrics[m]));
+			}
+			fwrite(header.data(), 1, header.size(), grid.file);
+		}
+		grids.push_back(grid);
+	}
+}
+
+BlockWriter::~BlockWriter()
+{
+	close();
+}
+
+int BlockWriter::getBaseSize() const
+{
+	return base_size;
+}
+
+int BlockWriter::getFrameSums() const
+{
+	return static_cast<int>(metrics.size())*base_rows*base_cols;
+}
+
+void BlockWriter::write(int frame, const double *frame_sums)
+{
+	size_t nbase = static_cast<size_t>(base_rows*base_cols);
+	for (size_t g=0; g<grids.size(); g++) {
+		Grid& grid = grids[g];
+		if (grid.file == NULL) {
+			continue;
+		}
+		record.clear();
+		putU32(record, static_cast<unsigned int>(frame));
+		for (size_t m=0; m<metrics.size(); m++) {
+			const double *base = frame_sums + m*nbase;
+			sums.assign(grid.pixels.size(), 0.0);
+			for (size_t b=0; b<nbase; b++) {
+				sums[static_cast<size_t>(grid.block[b])] += base[b];
+			}
+			for (size_t b=0; b<sums.size(); b++) {
+				double value;
+				if (metrics[m] == METRIC_SSIM) {
+					value = grid.windows[b] > 0.0 ? sums[b] / grid.windows[b] : std::numeric_limits<double>::quiet_NaN();
+				}
+				else if (metrics[m] == METRIC_PSNR) {
+					value = 10*log10(255*255/(sums[b] / grid.pixels[b]));
+				}
+				else {
+					// Same as the PSNR-HVS(-M) of a frame without errors
+					double s = sums[b] / grid.pixels[b];
+					value = s <= static_cast<double>(FLT_EPSILON) ? 100000.0 : 10*log10(255*255/s);
+				}
+				putFloat(record, static_cast<float>(value));
+			}
+		}
+		fwrite(record.data(), 1, record.size(), grid.file);
+	}
+}
+
+void BlockWriter::close()
+{
+	for (size_t g=0; g<grids.size(); g++) {
+		if (grids[g].file != NULL) {
+			fclose(grids[g].file);
+			grids[g].file = NULL;
+		}
+	}
+}
@@ -23,6 +23,7 @@
 //
 
 #include "EWPSNR.hpp"
+#include "Reduction.hpp"
 #include <cctype>
 #include <algorithm>
 #include <fstream>
@@ -56,15 +57,15 @@ float EWPSNR::compute(const cv::Mat& original, const cv::Mat& processed)
 float EWPSNR::WPSNR(const cv::Mat& original, const cv::Mat& processed, const cv::Mat& w)
 {
 	cv::Mat tmp(height,width,CV_32F);
-	cv::subtract(original, processed, tmp);
+	cv::subtract(original, processed, tmp, cv::noArray(), CV_32F);
 	cv::multiply(tmp, tmp, tmp);
 	cv::multiply(tmp, w, tmp);
-	return float(10*log10(255*255/(cv::mean(tmp).val[0]*original.cols*original.rows)));
+	return float(10*log10(255*255/Reduction::sum(tmp)));
 }
 
 void EWPSNR::compute_eye_weight(cv::Mat &w)
 {
-    float sum = 0;
+    CompensatedSum sum;
     for (int i=0; i<w.rows; i++) {
         for (int j=0; j<w.cols; j++) {
             float* data = w.ptr<float>(i, j);
@@ -72,10 +73,10 @@ void EWPSNR::compute_eye_weight(cv::Mat &w)
             for (auto &p: m_gazes[m_frame_no]) {
                 *data += static_cast<float>(retina_gaussian(j, i, p.first, p.second, 64, 64));
             }
-            sum += *data;
+            sum.add(static_cast<double>(*data));
         }
     }
-    w /= sum;
+    w /= sum.value();
 }
 
 double  EWPSNR::retina_gaussian(int x, int y, float x_e, float y_e, int sigma_x, int sigma_y)
@@ -91,8 +92,11 @@ bool EWPSNR::match_eye_track_data(std::string filename)
     std::transform(filename.begin(), filename.end(), filename.begin(), tolower);
     for(auto &i : m_eye_track_data) {
         if(filename.find(i.first) != std::string::npos) {
+            // The data of the same sequence is already loaded
+            if (i.first == m_id && !m_gazes.empty()) return true;
             m_id = i.first;
             m_path = i.second;
+            m_gazes.clear();
             if ( load_eye_track_data() ) {
                 return true;
             } else {
@@ -100,6 +104,9 @@ bool EWPSNR::match_eye_track_data(std::string filename)
             }
         }
     }
+    m_id.clear();
+    m_path.clear();
+    m_gazes.clear();
     return false;
 }
 
@@ -0,0 +1,238 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "FrameAligner.hpp"
+
+const double FrameAligner::MIN_PENALTY = 0.5;
+
+// Previous match of a processed frame preceded by unmatched ones only
+static const int FROM_START = -1;
+
+static long long nowNs()
+{
+	return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FrameAligner::FrameAligner(int h, int w, int m)
+{
+	CV_Assert(m >= 0 && m <= MAX_OFFSET);
+	height = h;
+	width = w;
+	max_offset = m;
+	offset = 0;
+	dropped = 0;
+	repeated = 0;
+	unmatched = 0;
+	seconds = 0.0;
+}
+
+bool FrameAligner::fingerprint(VideoYUV *video, int nbframes, std::vector<float>& prints)
+{
+	prints.assign(static_cast<size_t>(nbframes)*ROWS*COLS, 0.0f);
+	std::vector<imgpel> row(static_cast<size_t>(width));
+	for (int f=0; f<nbframes; f++) {
+		for (int r=0; r<ROWS; r++) {
+			// Middle row of each of ROWS bands of the frame
+			if (!video->readLumaRow(f, (2*r+1)*height/(2*ROWS), row.data())) return false;
+			float *dst = &prints[static_cast<size_t>((f*ROWS + r)*COLS)];
+			for (int c=0; c<COLS; c++) {
+				int begin = c*width/COLS;
+				int end = (c+1)*width/COLS;
+				int sum = 0;
+				for (int x=begin; x<end; x++) {
+					sum += row[static_cast<size_t>(x)];
+				}
+				dst[c] = static_cast<float>(sum)/static_cast<float>(end-begin);
+			}
+		}
+	}
+	return true;
+}
+
+double FrameAligner::distance(const float *a, const float *b)
+{
+	double sum = 0.0;
+	for (int k=0; k<ROWS*COLS; k++) {
+		sum += static_cast<double>(std::fabs(a[k] - b[k]));
+	}
+	return sum/(ROWS*COLS);
+}
+
+bool FrameAligner::align(VideoYUV *original, VideoYUV *processed, int nbframes)
+{
+	long long start = nowNs();
+	std::vector<float> prints[2];
+	if (!fingerprint(original, nbframes, prints[0]) || !fingerprint(processed, nbframes, prints[1])) return false;
+	const size_t len = ROWS*COLS;
+	const float *a = prints[0].data();
+	const float *b = prints[1].data();
+
+	// Penalty of a jump: half the median difference between consecutive original frames
+	std::vector<double> motion;
+	for (int i=1; i<nbframes; i++) {
+		motion.push_back(distance(a + static_cast<size_t>(i-1)*len, a + static_cast<size_t>(i)*len));
+	}
+	double penalty = MIN_PENALTY;
+	if (!motion.empty()) {
+		std::nth_element(motion.begin(), motion.begin() + static_cast<long>(motion.size()/2), motion.end());
+		penalty = std::max(penalty, motion[motion.size()/2]/2);
+	}
+
+	// Cost of the best matches of the processed frames up to j, processed
+	// frame j being matched with original frame j+k-max_offset (cost[k]),
+	// or unmatched after the last original frame (after)
+	const double inf = std::numeric_limits<double>::infinity();
+	int noffsets = 2*max_offset+1;
+	std::vector<double> cost(static_cast<size_t>(noffsets), inf), prev(static_cast<size_t>(noffsets));
+	double after = inf;
+	// Previous match of each match (k of processed frame j-1 or FROM_START),
+	// and of each unmatched frame after the end (-1: unmatched too)
+	std::vector<int> from(static_cast<size_t>(nbframes)*static_cast<size_t>(noffsets), FROM_START);
+	std::vector<int> end_from(static_cast<size_t>(nbframes), -1);
+	for (int j=0; j<nbframes; j++) {
+		prev.swap(cost);
+		after += penalty;
+		int last = nbframes-1 - (j-1) + max_offset;
+		if (j > 0 && last >= 0 && last < noffsets && prev[static_cast<size_t>(last)] + penalty < after) {
+			after = prev[static_cast<size_t>(last)] + penalty;
+			end_from[static_cast<size_t>(j)] = last;
+		}
+
+		// Best match of the previous processed frame after dropped original
+		// frames, min over s >= 1 of prev[k-s] + s*penalty, and its k, kept
+		// as a running minimum so that each offset takes constant time
+		double dropped_cost = inf;
+		int dropped_from = FROM_START;
+		for (int k=0; k<noffsets; k++) {
+			if (k > 0) {
+				if (prev[static_cast<size_t>(k-1)] <= dropped_cost) {
+					dropped_cost = prev[static_cast<size_t>(k-1)];
+					dropped_from = k-1;
+				}
+				dropped_cost += penalty;
+			}
+			int i = j + k - max_offset;
+			cost[static_cast<size_t>(k)] = inf;
+			if (i < 0 || i >= nbframes) continue;
+			// First processed frame: any of the first original frames
+			double best = j == 0 ? 0.0 : inf;
+			int arg = FROM_START;
+			if (j > 0) {
+				// Next original frame, then the same one, then after dropped ones
+				if (prev[static_cast<size_t>(k)] < best) {
+					best = prev[static_cast<size_t>(k)];
+					arg = k;
+				}
+				if (k+1 < noffsets && prev[static_cast<size_t>(k+1)] + penalty < best) {
+					best = prev[static_cast<size_t>(k+1)] + penalty;
+					arg = k+1;
+				}
+				if (dropped_cost < best) {
+					best = dropped_cost;
+					arg = dropped_from;
+				}
+				// First original frame after j unmatched processed frames
+				if (i == 0 && j*penalty < best) {
+					best = j*penalty;
+					arg = FROM_START;
+				}
+			}
+			cost[static_cast<size_t>(k)] = best + distance(b + static_cast<size_t>(j)*len, a + static_cast<size_t>(i)*len);
+			from[static_cast<size_t>(j)*static_cast<size_t>(noffsets) + static_cast<size_t>(k)] = arg;
+		}
+	}
+
+	// Best last state, then back to the first processed frame
+	int k = -1;
+	double best = after;
+	for (int c=0; c<noffsets; c++) {
+		if (cost[static_cast<size_t>(c)] < best) {
+			best = cost[static_cast<size_t>(c)];
+			k = c;
+		}
+	}
+	original_of.assign(static_cast<size_t>(nbframes), -1);
+	for (int j=nbframes-1; j>=0; j--) {
+		if (k < 0) {
+			k = end_from[static_cast<size_t>(j)];
+			continue;
+		}
+		original_of[static_cast<size_t>(j)] = j + k - max_offset;
+		k = from[static_cast<size_t>(j)*static_cast<size_t>(noffsets) + static_cast<size_t>(k)];
+		if (k == FROM_START) break;
+	}
+
+	offset = 0;
+	dropped = 0;
+	repeated = 0;
+	unmatched = 0;
+	int previous = -1;
+	for (int j=0; j<nbframes; j++) {
+		int i = original_of[static_cast<size_t>(j)];
+		if (i < 0) {
+			unmatched++;
+		}
+		else if (previous < 0) {
+			offset = i - j;
+		}
+		else if (i == previous) {
+			repeated++;
+		}
+		else {
+			dropped += i - previous - 1;
+		}
+		if (i >= 0) previous = i;
+	}
+	seconds = static_cast<double>(nowNs() - start)*1e-9;
+	return true;
+}
+
+int FrameAligner::getOriginal(int frame) const
+{
+	return frame >= 0 && frame < static_cast<int>(original_of.size()) ? original_of[static_cast<size_t>(frame)] : -1;
+}
+
+bool FrameAligner::save(const std::string& path) const
+{
+	FILE *f = fopen(path.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "Cannot write alignment %s\n", path.c_str());
+		return false;
+	}
+	fprintf(f, "frame,original\n");
+	for (size_t j=0; j<original_of.size(); j++) {
+		fprintf(f, "%d,%d\n", static_cast<int>(j), original_of[j]);
+	}
+	fclose(f);
+	return true;
+}
+
+void FrameAligner::report(FILE *out) const
+{
+	fprintf(out, "Alignment (%.3fs): offset %d, %d dropped, %d repeated and %d unmatched frame(s)\n", seconds, offset, dropped, repeated, unmatched);
+}
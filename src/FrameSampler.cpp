@@ -0,0 +1,159 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <math.h>
+#include <cmath>
+#include <limits>
+#include "FrameSampler.hpp"
+
+const int FrameSampler::MIN_SAMPLES;
+
+// Quantile of the normal distribution for a 95% confidence interval
+static const double CONFIDENCE_Z = 1.959964;
+
+FrameSampler::FrameSampler(int nbf, const bool sel[METRIC_SIZE], double tol)
+{
+	nbframes = nbf > 0 ? nbf : 0;
+	drawn.assign(static_cast<size_t>(nbframes), false);
+	ndrawn = 0;
+	round = 0;
+	stratum = 0;
+	tolerance = tol;
+	n = 0;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		selected[m] = sel[m];
+		scored[m] = 0;
+		mean_value[m] = 0.0;
+		m2[m] = 0.0;
+	}
+	progress = NULL;
+}
+
+int FrameSampler::next()
+{
+	while (ndrawn < nbframes) {
+		// Next round once all strata of the current one have been visited
+		if (stratum >= (1ULL << round)) {
+			round++;
+			stratum = 0;
+		}
+		// Bit-reversed index of the stratum, so that the strata visited
+		// consecutively are far apart
+		unsigned long long s = 0;
+		for (int b=0; b<round; b++) {
+			if (stratum & (1ULL << b)) s |= 1ULL << (round-1-b);
+		}
+		stratum++;
+		unsigned long long size = static_cast<unsigned long long>(nbframes);
+		int begin = static_cast<int>((s*size) >> round);
+		int end = static_cast<int>(((s+1)*size) >> round);
+		if (begin == end) continue;
+
+		// Random frame of the stratum, or the next one not drawn yet (the
+		// output of mt19937 is the same on all platforms, unlike that of
+		// the standard distributions)
+		int width = end-begin;
+		int offset = static_cast<int>(generator() % static_cast<unsigned int>(width));
+		for (int i=0; i<width; i++) {
+			int frame = begin + (offset+i) % width;
+			if (!drawn[static_cast<size_t>(frame)]) {
+				drawn[static_cast<size_t>(frame)] = true;
+				ndrawn++;
+				return frame;
+			}
+		}
+	}
+	return -1;
+}
+
+bool FrameSampler::add(const float result[METRIC_SIZE])
+{
+	n++;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		// No score (NaN), or an infinite one (PSNR of identical frames),
+		// which the running mean and variance cannot hold
+		if (!selected[m] || !std::isfinite(result[m])) continue;
+		scored[m]++;
+		double x = static_cast<double>(result[m]);
+		double delta = x - mean_value[m];
+		mean_value[m] += delta/scored[m];
+		m2[m] += delta*(x - mean_value[m]);
+	}
+
+	bool done = converged();
+	if (progress != NULL && (done || (n >= MIN_SAMPLES && (n & (n-1)) == 0))) {
+		report(progress);
+	}
+	return done;
+}
+
+bool FrameSampler::converged() const
+{
+	// The estimates are exact once all frames have been added
+	if (n >= nbframes) return true;
+	if (n < MIN_SAMPLES) return false;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (!selected[m]) continue;
+		double width = halfWidth(m);
+		// Not converged either while the estimates are not finite
+		if (!std::isfinite(width) || !std::isfinite(mean_value[m]) || width > tolerance*fabs(mean_value[m])) return false;
+	}
+	return true;
+}
+
+void FrameSampler::setProgress(FILE *out)
+{
+	progress = out;
+}
+
+int FrameSampler::count() const
+{
+	return n;
+}
+
+double FrameSampler::mean(int metric) const
+{
+	return scored[metric] > 0 ? mean_value[metric] : std::numeric_limits<double>::quiet_NaN();
+}
+
+double FrameSampler::halfWidth(int metric) const
+{
+	if (n >= nbframes) return 0.0;
+	int k = scored[metric];
+	if (k < 2) return HUGE_VAL;
+	double variance = m2[metric]/(k-1);
+	// The frames scored are assumed to be the same fraction of all frames
+	double correction = 1.0 - static_cast<double>(n)/nbframes;
+	return CONFIDENCE_Z*sqrt(variance/k*correction);
+}
+
+void FrameSampler::report(FILE *out) const
+{
+	fprintf(out, "Sampled %d of %d frames (95%% confidence):", n, nbframes);
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (selected[m]) fprintf(out, "  %s %.6f +/- %.6f", METRIC_NAME[m], mean(m), halfWidth(m));
+	}
+	fprintf(out, "\n");
+	fflush(out);
+}
@@ -0,0 +1,180 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+#include "AlignedMat.hpp"
+#include "GaussianFilter.hpp"
+#include "Kernels.hpp"
+
+// Fixed-point coefficients rounded to sum exactly to 1 << bits, the
+// rounding error is put on the central tap
+static std::vector<int> quantize(const std::vector<double>& k, int bits)
+{
+	std::vector<int> fixed;
+	int fixed_sum = 0;
+	for (size_t i=0; i<k.size(); i++) {
+		fixed.push_back(static_cast<int>(floor(k[i]*(1 << bits) + 0.5)));
+		fixed_sum += fixed.back();
+	}
+	fixed[k.size()/2] += (1 << bits) - fixed_sum;
+	return fixed;
+}
+
+GaussianFilter::GaussianFilter(int size, double sigma)
+{
+	ksize = size;
+
+	// Same coefficients as cv::getGaussianKernel
+	std::vector<double> k(static_cast<size_t>(ksize));
+	double sum = 0.0;
+	for (int i=0; i<ksize; i++) {
+		double x = i - (ksize-1)*0.5;
+		k[static_cast<size_t>(i)] = exp(-x*x/(2*sigma*sigma));
+		sum += k[static_cast<size_t>(i)];
+	}
+
+	for (int i=0; i<ksize; i++) {
+		k[static_cast<size_t>(i)] /= sum;
+		coeffs.push_back(static_cast<float>(k[static_cast<size_t>(i)]));
+	}
+	fixed_coeffs = quantize(k, COEFF_BITS);
+	moments_coeffs = quantize(k, MOMENTS_COEFF_BITS);
+
+	for (int i=0; i<ksize; i++) {
+		(i % 2 == 0 ? even_coeffs : odd_coeffs).push_back(coeffs[static_cast<size_t>(i)]);
+	}
+}
+
+const GaussianFilter& GaussianFilter::get(int ksize, double sigma)
+{
+	static std::mutex mutex;
+	static std::map<std::pair<int,double>, GaussianFilter*> filters;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	GaussianFilter *&filter = filters[std::make_pair(ksize, sigma)];
+	if (filter == NULL) {
+		filter = new GaussianFilter(ksize, sigma);
+	}
+	return *filter;
+}
+
+int GaussianFilter::getSize() const
+{
+	return ksize;
+}
+
+void GaussianFilter::apply(const cv::Mat& src, cv::Mat& dst) const
+{
+	int h = src.rows - (ksize-1);
+	int w = src.cols - (ksize-1);
+	dst.create(h, w, CV_32F);
+
+	const KernelTable& kernels = Kernels::get();
+	// The vertical pass covers the padding of aligned rows, in whole vectors
+	int n = AlignedMat::paddedCols(src, src.cols);
+	std::vector<float> row(static_cast<size_t>(n));
+
+	for (int y=0; y<h; y++) {
+		if (src.depth() == CV_8U) {
+			kernels.convolveColumn8u(src.ptr<uchar>(y), src.step1(), coeffs.data(), ksize, row.data(), n);
+		}
+		else {
+			kernels.convolveColumn(src.ptr<float>(y), src.step1(), coeffs.data(), ksize, row.data(), n);
+		}
+		kernels.convolveRow(row.data(), coeffs.data(), ksize, dst.ptr<float>(y), w);
+	}
+}
+
+void GaussianFilter::applyDecimated(const cv::Mat& src, cv::Mat& dst) const
+{
+	// Input columns used by the output
+	int n = 2*(dst.cols-1) + ksize;
+	CV_Assert(2*(dst.rows-1) + ksize <= src.rows && n <= src.cols);
+
+	const KernelTable& kernels = Kernels::get();
+	int padded = AlignedMat::paddedCols(src, n);
+	std::vector<float> row(static_cast<size_t>(padded));
+	std::vector<float> even(static_cast<size_t>((n+1)/2)), odd(static_cast<size_t>(n/2));
+
+	for (int y=0; y<dst.rows; y++) {
+		if (src.depth() == CV_8U) {
+			kernels.convolveColumn8u(src.ptr<uchar>(2*y), src.step1(), coeffs.data(), ksize, row.data(), padded);
+		}
+		else {
+			kernels.convolveColumn(src.ptr<float>(2*y), src.step1(), coeffs.data(), ksize, row.data(), padded);
+		}
+		// dst(x) = sum_t k(t)*row(2x+t) = sum_i k(2i)*even(x+i) + sum_i k(2i+1)*odd(x+i)
+		kernels.deinterleave(row.data(), even.data(), odd.data(), n);
+		kernels.convolveRow(even.data(), even_coeffs.data(), static_cast<int>(even_coeffs.size()), dst.ptr<float>(y), dst.cols);
+		kernels.convolveRowAdd(odd.data(), odd_coeffs.data(), static_cast<int>(odd_coeffs.size()), dst.ptr<float>(y), dst.cols);
+	}
+}
+
+void GaussianFilter::applyFixed(const cv::Mat& src, cv::Mat& dst) const
+{
+	int h = src.rows - (ksize-1);
+	int w = src.cols - (ksize-1);
+	dst.create(h, w, CV_32F);
+
+	const KernelTable& kernels = Kernels::get();
+	int n = AlignedMat::paddedCols(src, src.cols);
+	std::vector<unsigned short> row(static_cast<size_t>(n));
+	const float scale = 1.0f / static_cast<float>(1 << (ROW_BITS + COEFF_BITS));
+
+	for (int y=0; y<h; y++) {
+		kernels.convolveColumnFixed(src.ptr<uchar>(y), src.step1(), fixed_coeffs.data(), ksize, COEFF_BITS - ROW_BITS, row.data(), n);
+		kernels.convolveRowFixed(row.data(), fixed_coeffs.data(), ksize, scale, dst.ptr<float>(y), w);
+	}
+}
+
+void GaussianFilter::applyMomentsFixed(const cv::Mat& a, const cv::Mat& b, cv::Mat& mu1, cv::Mat& mu2, cv::Mat& e11, cv::Mat& e22, cv::Mat& e12) const
+{
+	CV_Assert(a.depth() == CV_8U && b.depth() == CV_8U && a.step1() == b.step1());
+	int h = a.rows - (ksize-1);
+	int w = a.cols - (ksize-1);
+	mu1.create(h, w, CV_32F);
+	mu2.create(h, w, CV_32F);
+	e11.create(h, w, CV_32F);
+	e22.create(h, w, CV_32F);
+	e12.create(h, w, CV_32F);
+
+	const KernelTable& kernels = Kernels::get();
+	const float scale = 1.0f / static_cast<float>(1 << (ROW_BITS + MOMENTS_COEFF_BITS));
+	int n = std::min(AlignedMat::paddedCols(a, a.cols), AlignedMat::paddedCols(b, b.cols));
+	std::vector<unsigned short> row1(static_cast<size_t>(n)), row2(static_cast<size_t>(n));
+	std::vector<unsigned int> row11(static_cast<size_t>(n)), row22(static_cast<size_t>(n)), row12(static_cast<size_t>(n));
+
+	for (int y=0; y<h; y++) {
+		kernels.momentsColumnFixed(a.ptr<uchar>(y), b.ptr<uchar>(y), a.step1(), fixed_coeffs.data(), ksize, COEFF_BITS - ROW_BITS, row1.data(), row2.data(), row11.data(), row22.data(), row12.data(), n);
+		kernels.convolveRowFixed(row1.data(), moments_coeffs.data(), ksize, scale, mu1.ptr<float>(y), w);
+		kernels.convolveRowFixed(row2.data(), moments_coeffs.data(), ksize, scale, mu2.ptr<float>(y), w);
+		kernels.convolveRowFixed32(row11.data(), moments_coeffs.data(), ksize, scale, e11.ptr<float>(y), w);
+		kernels.convolveRowFixed32(row22.data(), moments_coeffs.data(), ksize, scale, e22.ptr<float>(y), w);
+		kernels.convolveRowFixed32(row12.data(), moments_coeffs.data(), ksize, scale, e12.ptr<float>(y), w);
+	}
+}
@@ -0,0 +1,447 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Job.hpp"
+#include "Pyramid.hpp"
+#include "VideoYUV.hpp"
+
+enum Params {
+	PARAM_ORIGINAL = 0,	// Original video stream (YUV)
+	PARAM_PROCESSED,	// Processed video stream (YUV)
+	PARAM_HEIGHT,		// Height
+	PARAM_WIDTH,		// Width
+	PARAM_NBFRAMES,		// Number of frames
+	PARAM_CHROMA,		// Chroma format
+	PARAM_RESULTS,		// Output file for results
+	PARAM_METRICS,		// Metric(s) to compute
+	PARAM_SIZE
+};
+
+// Names of the packed and semi-planar formats, from FORMAT_NV12
+static const char *PACKED_FORMAT_NAME[] = {"NV12", "P010", "UYVY", "YUYV"};
+
+Job::Job()
+{
+	height = 0;
+	width = 0;
+	nbframes = 0;
+	chroma = CHROMA_SUBSAMP_420;
+	stride = 0;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		selected[m] = false;
+	}
+	ssim_fixed = false;
+	summary = false;
+	sample = 0.0;
+	live = 0.0;
+	deadline = 0.0;
+	maps = 0;
+	align = 0;
+	checkpoint = 0;
+	resume = false;
+}
+
+// Parse the value of option "name=value" as a positive real number
+// Print the error and return -1 if it is not valid
+static double parseReal(const char *arg, const char *name)
+{
+	char *endptr = NULL;
+	double value = strtod(arg+strlen(name), &endptr);
+	if (*endptr || !(value > 0.0 && value < HUGE_VAL)) {
+		fprintf(stderr, "Incorrect value for option %s %s\n", name, arg+strlen(name));
+		return -1.0;
+	}
+	return value;
+}
+
+// Option "name=value" with a real value, exact when parsed back
+static std::string realOption(const char *name, double value)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%.17g", value);
+	return std::string(name) + text;
+}
+
+int Job::parseOption(const char *arg, const char *name)
+{
+	char *endptr = NULL;
+	int value = static_cast<int>(strtol(arg+strlen(name), &endptr, 10));
+	if (*endptr || value < 0) {
+		fprintf(stderr, "Incorrect value for option %s %s\n", name, arg+strlen(name));
+		return -1;
+	}
+	return value;
+}
+
+bool Job::parse(const std::vector<std::string>& args)
+{
+	// Check number of input parameters (counting the program name)
+	if (args.size() < PARAM_SIZE) {
+		fprintf(stderr, "Check software usage: at least %d parameters are required.\n", PARAM_SIZE+1);
+		return false;
+	}
+
+	// Input parameters
+	original = args[PARAM_ORIGINAL];
+	processed = args[PARAM_PROCESSED];
+	output = args[PARAM_RESULTS];
+	char *endptr = NULL;
+	height = static_cast<int>(strtol(args[PARAM_HEIGHT].c_str(), &endptr, 10));
+	if (*endptr) {
+		fprintf(stderr, "Incorrect value for video height: %s\n", args[PARAM_HEIGHT].c_str());
+		return false;
+	}
+	width = static_cast<int>(strtol(args[PARAM_WIDTH].c_str(), &endptr, 10));
+	if (*endptr) {
+		fprintf(stderr, "Incorrect value for video width: %s\n", args[PARAM_WIDTH].c_str());
+		return false;
+	}
+	nbframes = static_cast<int>(strtol(args[PARAM_NBFRAMES].c_str(), &endptr, 10));
+	if (*endptr) {
+		fprintf(stderr, "Incorrect value for number of frames: %s\n", args[PARAM_NBFRAMES].c_str());
+		return false;
+	}
+	chroma = static_cast<int>(strtol(args[PARAM_CHROMA].c_str(), &endptr, 10));
+	for (int f=FORMAT_NV12; f<=FORMAT_YUYV; f++) {
+		if (args[PARAM_CHROMA] == PACKED_FORMAT_NAME[f-FORMAT_NV12]) {
+			chroma = f;
+			endptr = NULL;
+		}
+	}
+	if (endptr != NULL && *endptr) {
+		fprintf(stderr, "Incorrect value for chroma: %s\n", args[PARAM_CHROMA].c_str());
+		return false;
+	}
+
+	// Metrics and options of the job
+	for (size_t i=PARAM_CHROMA+1; i<args.size(); i++) {
+		const char *arg = args[i].c_str();
+		bool found = false;
+		for (int m=0; m<METRIC_SIZE; m++) {
+			if (strcmp(arg, METRIC_NAME[m]) == 0) {
+				selected[m] = true;
+				found = true;
+			}
+		}
+		if (found || i == PARAM_RESULTS) continue;
+
+		if (strcmp(arg, "--ssim-fixed") == 0) {
+			ssim_fixed = true;
+		}
+		else if (strncmp(arg, "--stride=", 9) == 0) {
+			stride = parseOption(arg, "--stride=");
+			if (stride < 0) return false;
+		}
+		else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+			checkpoint = parseOption(arg, "--checkpoint=");
+			if (checkpoint < 0) return false;
+		}
+		else if (strcmp(arg, "--summary") == 0) {
+			summary = true;
+		}
+		else if (strncmp(arg, "--sample=", 9) == 0) {
+			sample = parseReal(arg, "--sample=");
+			if (sample <= 0.0) return false;
+			if (sample >= 1.0) {
+				fprintf(stderr, "Incorrect value for option --sample= %s\n", arg+9);
+				return false;
+			}
+		}
+		else if (strncmp(arg, "--live=", 7) == 0) {
+			live = parseReal(arg, "--live=");
+			if (live <= 0.0) return false;
+		}
+		else if (strncmp(arg, "--deadline=", 11) == 0) {
+			deadline = parseReal(arg, "--deadline=");
+			if (deadline <= 0.0) return false;
+		}
+		else if (strncmp(arg, "--blocks=", 9) == 0) {
+			blocks.clear();
+			const char *sizes = arg+9;
+			do {
+				long size = strtol(sizes, &endptr, 10);
+				if (endptr == sizes || (*endptr && *endptr != ',') || size <= 0 || size % 8 != 0 || size > height || size > width) {
+					fprintf(stderr, "Incorrect value for option --blocks= %s (sizes have to be multiples of 8, at most the size of the video)\n", arg+9);
+					return false;
+				}
+				blocks.push_back(static_cast<int>(size));
+				sizes = *endptr ? endptr+1 : endptr;
+			} while (*sizes);
+		}
+		else if (strncmp(arg, "--maps=", 7) == 0) {
+			maps = parseOption(arg, "--maps=");
+			if (maps < 0) return false;
+			if (maps != 8 && maps != 16) {
+				fprintf(stderr, "Incorrect value for option --maps= %s (8 or 16 bits)\n", arg+7);
+				return false;
+			}
+		}
+		else if (strncmp(arg, "--roi-mask=", 11) == 0 && arg[11]) {
+			roi_mask = arg+11;
+		}
+		else if (strncmp(arg, "--roi-rects=", 12) == 0 && arg[12]) {
+			roi_rects = arg+12;
+		}
+		else if (strncmp(arg, "--align=", 8) == 0) {
+			align = parseOption(arg, "--align=");
+			if (align < 0) return false;
+			if (align > FrameAligner::MAX_OFFSET || height < FrameAligner::ROWS || width < FrameAligner::COLS) {
+				fprintf(stderr, "Incorrect value for option --align= %s (at most %d, with at least %dx%d pixels)\n", arg+8, FrameAligner::MAX_OFFSET, FrameAligner::COLS, FrameAligner::ROWS);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--resume") == 0) {
+			resume = true;
+		}
+		else if (strncmp(arg, "--", 2) == 0) {
+			options.push_back(args[i]);
+		}
+	}
+
+	// The output files of a sample are not written in frame order, those
+	// of a live source do not have all frames
+	if (sample > 0.0 && (checkpoint > 0 || resume)) {
+		fprintf(stderr, "--sample cannot be used with --checkpoint or --resume.\n");
+		return false;
+	}
+	if (live > 0.0 && (sample > 0.0 || checkpoint > 0 || resume)) {
+		fprintf(stderr, "--live cannot be used with --sample, --checkpoint or --resume.\n");
+		return false;
+	}
+	// The frames read are chosen by the sampler or the live source
+	if (align > 0 && (sample > 0.0 || live > 0.0)) {
+		fprintf(stderr, "--align cannot be used with --sample or --live.\n");
+		return false;
+	}
+	if (deadline > 0.0 && live <= 0.0) {
+		fprintf(stderr, "--deadline requires --live.\n");
+		return false;
+	}
+	// The grids and maps are not checkpointed
+	if ((!blocks.empty() || maps > 0) && (checkpoint > 0 || resume)) {
+		fprintf(stderr, "--blocks and --maps cannot be used with --checkpoint or --resume.\n");
+		return false;
+	}
+	if (maps > 0 && !selected[METRIC_SSIM] && !selected[METRIC_VIFP]) {
+		fprintf(stderr, "--maps requires SSIM or VIFP.\n");
+		return false;
+	}
+	if (!roi_mask.empty() && !roi_rects.empty()) {
+		fprintf(stderr, "--roi-mask and --roi-rects cannot be used together.\n");
+		return false;
+	}
+	bool weighted = false;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		weighted = weighted || (selected[m] && METRIC_WEIGHTS[m]);
+	}
+	if ((!roi_mask.empty() || !roi_rects.empty()) && !weighted) {
+		fprintf(stderr, "--roi-mask and --roi-rects require PSNR, SSIM, MSSSIM, PSNRHVS or PSNRHVSM.\n");
+		return false;
+	}
+	// The grids and maps are not weighted
+	if ((!roi_mask.empty() || !roi_rects.empty()) && (!blocks.empty() || maps > 0)) {
+		fprintf(stderr, "--roi-mask and --roi-rects cannot be used with --blocks or --maps.\n");
+		return false;
+	}
+	if (!blocks.empty() && !selected[METRIC_PSNR] && !selected[METRIC_SSIM] && !selected[METRIC_PSNRHVS] && !selected[METRIC_PSNRHVSM]) {
+		fprintf(stderr, "--blocks requires PSNR, SSIM, PSNRHVS or PSNRHVSM.\n");
+		return false;
+	}
+
+	if (!VideoYUV::check(height, width, chroma, stride)) return false;
+
+	// Check size for VIFp downsampling
+	int min_size = Pyramid(PYRAMID_VIFP).getMinSize();
+	if (selected[METRIC_VIFP] && (height < min_size || width < min_size)) {
+		fprintf(stderr, "VIFp: 'height' and 'width' have to be at least %d.\n", min_size);
+		return false;
+	}
+	// Check size for MS-SSIM downsampling
+	min_size = Pyramid(PYRAMID_MSSSIM).getMinSize();
+	if (selected[METRIC_MSSSIM] && (height < min_size || width < min_size)) {
+		fprintf(stderr, "MS-SSIM: 'height' and 'width' have to be at least %d.\n", min_size);
+		return false;
+	}
+	return true;
+}
+
+double Job::getCost() const
+{
+	return static_cast<double>(nbframes)*height*width;
+}
+
+std::vector<std::string> Job::getArguments() const
+{
+	std::vector<std::string> args;
+	args.push_back(original);
+	args.push_back(processed);
+	args.push_back(std::to_string(height));
+	args.push_back(std::to_string(width));
+	args.push_back(std::to_string(nbframes));
+	args.push_back(chroma >= FORMAT_NV12 ? PACKED_FORMAT_NAME[chroma-FORMAT_NV12] : std::to_string(chroma));
+	args.push_back(output);
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (selected[m]) args.push_back(METRIC_NAME[m]);
+	}
+	if (stride > 0) args.push_back("--stride=" + std::to_string(stride));
+	if (ssim_fixed) args.push_back("--ssim-fixed");
+	if (summary) args.push_back("--summary");
+	if (sample > 0.0) args.push_back(realOption("--sample=", sample));
+	if (live > 0.0) args.push_back(realOption("--live=", live));
+	if (deadline > 0.0) args.push_back(realOption("--deadline=", deadline));
+	if (!blocks.empty()) {
+		std::string arg = "--blocks=";
+		for (size_t b=0; b<blocks.size(); b++) {
+			arg += (b > 0 ? "," : "") + std::to_string(blocks[b]);
+		}
+		args.push_back(arg);
+	}
+	if (maps > 0) args.push_back("--maps=" + std::to_string(maps));
+	if (!roi_mask.empty()) args.push_back("--roi-mask=" + roi_mask);
+	if (!roi_rects.empty()) args.push_back("--roi-rects=" + roi_rects);
+	if (align > 0) args.push_back("--align=" + std::to_string(align));
+	if (checkpoint > 0) args.push_back("--checkpoint=" + std::to_string(checkpoint));
+	if (resume) args.push_back("--resume");
+	return args;
+}
+
+std::string Job::getCheckpointKey() const
+{
+	Job job = *this;
+	job.summary = false;
+	job.checkpoint = 0;
+	job.resume = false;
+	return join(job.getArguments());
+}
+
+bool Job::split(const std::string& line, std::vector<std::string>& args)
+{
+	size_t i = 0;
+	while (i < line.size()) {
+		if (isspace(static_cast<unsigned char>(line[i]))) {
+			i++;
+			continue;
+		}
+		std::string arg;
+		while (i < line.size() && !isspace(static_cast<unsigned char>(line[i]))) {
+			if (line[i] == '"') {
+				size_t end = line.find('"', i+1);
+				if (end == std::string::npos) return false;
+				arg += line.substr(i+1, end-i-1);
+				i = end+1;
+			}
+			else {
+				arg += line[i++];
+			}
+		}
+		args.push_back(arg);
+	}
+	return true;
+}
+
+std::string Job::join(const std::vector<std::string>& args)
+{
+	std::string line;
+	for (size_t i=0; i<args.size(); i++) {
+		bool blank = args[i].empty();
+		for (size_t c=0; c<args[i].size(); c++) {
+			if (isspace(static_cast<unsigned char>(args[i][c]))) blank = true;
+		}
+		if (i > 0) line += ' ';
+		line += blank ? '"' + args[i] + '"' : args[i];
+	}
+	return line;
+}
+
+ResultWriter *Job::createWriter(const std::string& prefix, bool echo, int& first_frame) const
+{
+	std::string path = prefix + ".checkpoint";
+	std::string key = getCheckpointKey();
+	Checkpoint state;
+	first_frame = 0;
+	if (resume) {
+		if (!state.load(path)) return NULL;
+		if (state.frame >= 0 && state.job != key) {
+			fprintf(stderr, "Checkpoint %s was saved for another job: %s\n", path.c_str(), state.job.c_str());
+			return NULL;
+		}
+		if (state.frame >= 0) first_frame = state.frame;
+	}
+
+	ResultWriter *writer = new ResultWriter(prefix.c_str(), selected, echo, resume && state.frame >= 0 ? &state : NULL);
+	if (!writer->isOpen()) {
+		delete writer;
+		return NULL;
+	}
+	writer->setSummary(summary);
+	if (checkpoint > 0 || resume) {
+		writer->setCheckpoint(path, checkpoint, key);
+	}
+	return writer;
+}
+
+LiveScheduler *Job::createScheduler(const std::string& prefix) const
+{
+	if (live <= 0.0) return NULL;
+	double max_lag = deadline > 0.0 ? deadline/1000 : 1/live;
+	return new LiveScheduler(live, max_lag, selected, prefix + "_live.csv");
+}
+
+BlockWriter *Job::createBlockWriter(const std::string& prefix) const
+{
+	if (blocks.empty()) return NULL;
+	return new BlockWriter(prefix, height, width, blocks, selected);
+}
+
+MapWriter *Job::createMapWriter(const std::string& prefix) const
+{
+	if (maps <= 0) return NULL;
+	return new MapWriter(prefix, height, width, maps, selected);
+}
+
+bool Job::createWeightMask(WeightMask *&mask) const
+{
+	mask = NULL;
+	if (!roi_mask.empty()) {
+		mask = WeightMask::openVideo(roi_mask.c_str(), height, width, nbframes);
+	}
+	else if (!roi_rects.empty()) {
+		mask = WeightMask::openRectangles(roi_rects.c_str(), height, width);
+	}
+	else {
+		return true;
+	}
+	return mask != NULL;
+}
+
+FrameAligner *Job::createAligner() const
+{
+	if (align <= 0) return NULL;
+	return new FrameAligner(height, width, align);
+}
@@ -0,0 +1,130 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Kernels.hpp"
+
+// Tables defined by the Kernels_<isa>.cpp files
+extern const KernelTable KERNELS_BASELINE;
+#ifdef VQMT_HAVE_SSE42
+extern const KernelTable KERNELS_SSE42;
+#endif
+#ifdef VQMT_HAVE_AVX2
+extern const KernelTable KERNELS_AVX2;
+#endif
+#ifdef VQMT_HAVE_AVX512
+extern const KernelTable KERNELS_AVX512;
+#endif
+
+const char *ISA_NAME[ISA_SIZE] = {"baseline", "sse4.2", "avx2", "avx512"};
+
+static const KernelTable *table = &KERNELS_BASELINE;
+static KernelISA current = ISA_BASELINE;
+
+static const KernelTable *getTable(KernelISA isa)
+{
+	switch (isa) {
+#ifdef VQMT_HAVE_SSE42
+		case ISA_SSE42:
+			return &KERNELS_SSE42;
+#endif
+#ifdef VQMT_HAVE_AVX2
+		case ISA_AVX2:
+			return &KERNELS_AVX2;
+#endif
+#ifdef VQMT_HAVE_AVX512
+		case ISA_AVX512:
+			return &KERNELS_AVX512;
+#endif
+		case ISA_BASELINE:
+			return &KERNELS_BASELINE;
+		default:
+			return NULL;
+	}
+}
+
+bool Kernels::supported(KernelISA isa)
+{
+	if (getTable(isa) == NULL) return false;
+
+	switch (isa) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		case ISA_SSE42:
+			return __builtin_cpu_supports("sse4.2");
+		case ISA_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case ISA_AVX512:
+			return __builtin_cpu_supports("avx512f");
+#endif
+		case ISA_BASELINE:
+			return true;
+		default:
+			return false;
+	}
+}
+
+void Kernels::init(const char *isa)
+{
+	if (isa == NULL) {
+		isa = getenv("VQMT_ISA");
+	}
+
+	if (isa == NULL || *isa == '\0') {
+		// Best instruction set supported by the CPU
+		current = ISA_BASELINE;
+		for (int i=ISA_SIZE-1; i>ISA_BASELINE; i--) {
+			if (supported(static_cast<KernelISA>(i))) {
+				current = static_cast<KernelISA>(i);
+				break;
+			}
+		}
+	}
+	else {
+		int i = 0;
+		while (i < ISA_SIZE && strcmp(isa, ISA_NAME[i]) != 0) i++;
+		if (i == ISA_SIZE) {
+			fprintf(stderr, "Unknown instruction set: %s (baseline, sse4.2, avx2 or avx512)\n", isa);
+			exit(EXIT_FAILURE);
+		}
+		if (!supported(static_cast<KernelISA>(i))) {
+			fprintf(stderr, "Instruction set %s is not supported by this CPU or build\n", isa);
+			exit(EXIT_FAILURE);
+		}
+		current = static_cast<KernelISA>(i);
+	}
+
+	table = getTable(current);
+}
+
+const KernelTable& Kernels::get()
+{
+	return *table;
+}
+
+KernelISA Kernels::getISA()
+{
+	return current;
+}
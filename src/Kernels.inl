@@ -0,0 +1,1065 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+//
+// Kernel implementations, included once per instruction set by the
+// Kernels_<isa>.cpp files, each compiled with its own target flags.
+// KERNEL_TABLE is the name of the table to define.
+//
+// The code uses GCC vector extensions: W is the native number of floats
+// per register (4 for SSE, 8 for AVX2, 16 for AVX-512). Everything lives in
+// an anonymous namespace so the variants never get mixed up at link time.
+//
+
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "Kernels.hpp"
+
+namespace {
+
+#if defined(__AVX512F__)
+const int W = 16;
+#elif defined(__AVX__)
+const int W = 8;
+#else
+const int W = 4;
+#endif
+
+typedef float vfloat __attribute__((vector_size(W*sizeof(float))));
+typedef float vfloat4 __attribute__((vector_size(4*sizeof(float))));
+typedef float vfloat8 __attribute__((vector_size(8*sizeof(float))));
+typedef double vdouble4 __attribute__((vector_size(4*sizeof(double))));
+typedef int vint __attribute__((vector_size(W*sizeof(int))));
+typedef unsigned int vuint __attribute__((vector_size(W*sizeof(unsigned int))));
+typedef unsigned short vushort __attribute__((vector_size(W*sizeof(unsigned short))));
+typedef unsigned char vuchar __attribute__((vector_size(W*sizeof(unsigned char))));
+
+// Orthonormal 8x8 DCT-II matrix
+// c(u,i) = a(u) cos(pi (2i+1) u / 16), a(0) = sqrt(1/8), a(u) = sqrt(2/8)
+const float DCT[8][8] = {{ 0.35355338f,  0.35355338f,  0.35355338f,  0.35355338f,  0.35355338f,  0.35355338f,  0.35355338f,  0.35355338f},
+                          { 0.49039263f,  0.4157348f,  0.27778512f,  0.09754516f, -0.09754516f, -0.27778512f, -0.4157348f, -0.49039263f},
+                          { 0.46193975f,  0.19134171f, -0.19134171f, -0.46193975f, -0.46193975f, -0.19134171f,  0.19134171f,  0.46193975f},
+                          { 0.4157348f, -0.09754516f, -0.49039263f, -0.27778512f,  0.27778512f,  0.49039263f,  0.09754516f, -0.4157348f},
+                          { 0.35355338f, -0.35355338f, -0.35355338f,  0.35355338f,  0.35355338f, -0.35355338f, -0.35355338f,  0.35355338f},
+                          { 0.27778512f, -0.49039263f,  0.09754516f,  0.4157348f, -0.4157348f, -0.09754516f,  0.49039263f, -0.27778512f},
+                          { 0.19134171f, -0.46193975f,  0.46193975f, -0.19134171f, -0.19134171f,  0.46193975f, -0.46193975f,  0.19134171f},
+                          { 0.09754516f, -0.27778512f,  0.4157348f, -0.49039263f,  0.49039263f, -0.4157348f,  0.27778512f, -0.09754516f}};
+
+// Unaligned loads and stores
+template<typename V, typename T> inline void load(V& v, const T *p)
+{
+	memcpy(&v, p, sizeof(V));
+}
+
+template<typename V, typename T> inline void store(T *p, const V& v)
+{
+	memcpy(p, &v, sizeof(V));
+}
+
+// Zero extension of W bytes or W unsigned shorts to ints, and narrowing of
+// ints in [0, 32767] to unsigned shorts (the generic conversions are
+// not vectorized well by the compiler for these types). The AVX-512
+// versions use an all-ones mask, the unmasked intrinsics trigger spurious
+// -Wmaybe-uninitialized warnings with some compilers.
+inline vint widen(const unsigned char *p)
+{
+#if defined(__AVX512F__)
+	__m512i v = _mm512_maskz_cvtepu8_epi32(0xffff, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+#elif defined(__AVX2__)
+	__m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+#elif defined(__SSE2__) && !defined(__AVX__)
+	int bytes;
+	memcpy(&bytes, p, sizeof(bytes));
+#if defined(__SSE4_1__)
+	__m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes));
+#else
+	__m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+#endif
+#else
+	vuchar v;
+	load(v, p);
+	return __builtin_convertvector(v, vint);
+#endif
+	vint r;
+	memcpy(&r, &v, sizeof(r));
+	return r;
+}
+
+inline vint widen(const unsigned short *p)
+{
+#if defined(__AVX512F__)
+	__m512i v = _mm512_maskz_cvtepu16_epi32(0xffff, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+#elif defined(__AVX2__)
+	__m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+#elif defined(__SSE4_1__) && !defined(__AVX__)
+	__m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+#elif defined(__SSE2__) && !defined(__AVX__)
+	__m128i v = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+#else
+	vushort v;
+	load(v, p);
+	return __builtin_convertvector(v, vint);
+#endif
+	vint r;
+	memcpy(&r, &v, sizeof(r));
+	return r;
+}
+
+inline void narrow(unsigned short *p, const vint& x)
+{
+#if defined(__AVX512F__)
+	__m512i v;
+	memcpy(&v, &x, sizeof(v));
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_maskz_cvtepi32_epi16(0xffff, v));
+#elif defined(__AVX2__)
+	__m256i v;
+	memcpy(&v, &x, sizeof(v));
+	v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(v));
+#elif defined(__SSE2__) && !defined(__AVX__)
+	__m128i v;
+	memcpy(&v, &x, sizeof(v));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(v, v));
+#else
+	store(p, __builtin_convertvector(x, vushort));
+#endif
+}
+
+// Row sum in the order of Reduction::sumRow: element j goes to accumulator
+// j%4 for the full groups of four, the remaining ones to accumulator 0
+class RowSum {
+public:
+	RowSum()
+	{
+		acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+	}
+	template<typename V> void add(const V& v)
+	{
+		float buf[sizeof(V)/sizeof(float)];
+		store(buf, v);
+		for (size_t q=0; q<sizeof(V)/sizeof(float); q+=4) {
+			vfloat4 v4;
+			load(v4, buf+q);
+			acc += __builtin_convertvector(v4, vdouble4);
+		}
+	}
+	void addTail(float x)
+	{
+		acc[0] += static_cast<double>(x);
+	}
+	// Last n < W elements of a row, in the same order as sumRow
+	void addLast(const vfloat& v, int n)
+	{
+		float buf[W];
+		store(buf, v);
+		int q = 0;
+		for (; q+4<=n; q+=4) {
+			vfloat4 v4;
+			load(v4, buf+q);
+			add(v4);
+		}
+		for (; q<n; q++) {
+			addTail(buf[q]);
+		}
+	}
+	double value() const
+	{
+		return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+	}
+private:
+	vdouble4 acc;
+};
+
+// Sums of a row over blocks of consecutive elements, element j going to
+// blocks[(j+first)/size]. Elements are added by groups of 4 as in RowSum,
+// those of a group that straddles two blocks one by one, so the sums do
+// not depend on the instruction set. Elements have to be added in order.
+// Nothing is summed if blocks is NULL
+class BlockRowSum {
+public:
+	BlockRowSum(int first, int block_size, double *block_sums) : size(block_size), blocks(block_sums)
+	{
+		block = blocks != NULL ? first/size : 0;
+		end = blocks != NULL ? (block+1)*size - first : 0;
+		acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+	}
+	~BlockRowSum()
+	{
+		flush();
+	}
+	// Elements j to j+3
+	void add4(const vfloat4& v, int j)
+	{
+		if (blocks == NULL) return;
+		if (j+3 < end) {
+			acc += __builtin_convertvector(v, vdouble4);
+			return;
+		}
+		float buf[4];
+		store(buf, v);
+		for (int q=0; q<4; q++) {
+			addTail(buf[q], j+q);
+		}
+	}
+	// Elements j to j+size(V)-1
+	template<typename V> void add(const V& v, int j)
+	{
+		float buf[sizeof(V)/sizeof(float)];
+		store(buf, v);
+		for (int q=0; q<static_cast<int>(sizeof(V)/sizeof(float)); q+=4) {
+			vfloat4 v4;
+			load(v4, buf+q);
+			add4(v4, j+q);
+		}
+	}
+	void addTail(float x, int j)
+	{
+		if (blocks == NULL) return;
+		while (j >= end) {
+			flush();
+			block++;
+			end += size;
+		}
+		acc[0] += static_cast<double>(x);
+	}
+private:
+	void flush()
+	{
+		if (blocks == NULL) return;
+		blocks[block] += (acc[0] + acc[1]) + (acc[2] + acc[3]);
+		acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+	}
+
+	int size;
+	double *blocks;
+	int block;
+	int end;	// first element of the next block
+	vdouble4 acc;
+};
+
+double sumRow(const float *row, int n)
+{
+	RowSum s;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat v;
+		load(v, row+j);
+		s.add(v);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 v;
+		load(v, row+j);
+		s.add(v);
+	}
+	for (; j<n; j++) {
+		s.addTail(row[j]);
+	}
+	return s.value();
+}
+
+double sumSquaredDiff(const float *a, const float *b, int n)
+{
+	RowSum s;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat va, vb;
+		load(va, a+j);
+		load(vb, b+j);
+		vfloat d = va - vb;
+		s.add(d*d);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 va, vb;
+		load(va, a+j);
+		load(vb, b+j);
+		vfloat4 d = va - vb;
+		s.add(d*d);
+	}
+	for (; j<n; j++) {
+		float d = a[j] - b[j];
+		s.addTail(d*d);
+	}
+	return s.value();
+}
+
+// Squared differences of 8-bit samples fit in 16 bits, so the sums are
+// exact in 32-bit lanes for rows of up to 65536*W samples
+double sumSquaredDiff8u(const unsigned char *a, const unsigned char *b, int n)
+{
+	vuint s = {0};
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vint d = widen(a+j) - widen(b+j);
+		s += __builtin_convertvector(d*d, vuint);
+	}
+	unsigned long long total = 0;
+	for (int k=0; k<W; k++) {
+		total += s[k];
+	}
+	for (; j<n; j++) {
+		int d = a[j] - b[j];
+		total += static_cast<unsigned int>(d*d);
+	}
+	return static_cast<double>(total);
+}
+
+// Weighted sums in the order of sumRow, of the products of the squared
+// differences and the weights
+double sumSquaredDiffWeighted(const float *a, const float *b, const float *weights, int n)
+{
+	RowSum s;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat va, vb, vw;
+		load(va, a+j);
+		load(vb, b+j);
+		load(vw, weights+j);
+		vfloat d = va - vb;
+		s.add(d*d*vw);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 va, vb, vw;
+		load(va, a+j);
+		load(vb, b+j);
+		load(vw, weights+j);
+		vfloat4 d = va - vb;
+		s.add(d*d*vw);
+	}
+	for (; j<n; j++) {
+		float d = a[j] - b[j];
+		s.addTail(d*d*weights[j]);
+	}
+	return s.value();
+}
+
+// The squared differences of 8-bit samples are exact in float
+double sumSquaredDiffWeighted8u(const unsigned char *a, const unsigned char *b, const float *weights, int n)
+{
+	RowSum s;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vint d = widen(a+j) - widen(b+j);
+		vfloat vw;
+		load(vw, weights+j);
+		s.add(__builtin_convertvector(d*d, vfloat)*vw);
+	}
+	for (; j+4<=n; j+=4) {
+		float sq[4];
+		for (int q=0; q<4; q++) {
+			int d = a[j+q] - b[j+q];
+			sq[q] = static_cast<float>(d*d);
+		}
+		vfloat4 vd, vw;
+		load(vd, sq);
+		load(vw, weights+j);
+		s.add(vd*vw);
+	}
+	for (; j<n; j++) {
+		int d = a[j] - b[j];
+		s.addTail(static_cast<float>(d*d)*weights[j]);
+	}
+	return s.value();
+}
+
+void moments(const float *x, const float *y, float *xx, float *yy, float *xy, int n)
+{
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat vx, vy;
+		load(vx, x+j);
+		load(vy, y+j);
+		store(xx+j, vx*vx);
+		store(yy+j, vy*vy);
+		store(xy+j, vx*vy);
+	}
+	for (; j<n; j++) {
+		xx[j] = x[j]*x[j];
+		yy[j] = y[j]*y[j];
+		xy[j] = x[j]*y[j];
+	}
+}
+
+// Products of 8-bit samples are computed in integers, exactly as in float
+void moments8u(const unsigned char *x, const unsigned char *y, float *xx, float *yy, float *xy, int n)
+{
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vint vx = widen(x+j);
+		vint vy = widen(y+j);
+		store(xx+j, __builtin_convertvector(vx*vx, vfloat));
+		store(yy+j, __builtin_convertvector(vy*vy, vfloat));
+		store(xy+j, __builtin_convertvector(vx*vy, vfloat));
+	}
+	for (; j<n; j++) {
+		xx[j] = static_cast<float>(x[j]*x[j]);
+		yy[j] = static_cast<float>(y[j]*y[j]);
+		xy[j] = static_cast<float>(x[j]*y[j]);
+	}
+}
+
+// cs = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2)
+// ssim = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2))
+template<typename V> inline void ssimMaps(const V& mu1, const V& mu2, const V& e11, const V& e22, const V& e12, float C1, float C2, V& ssim, V& cs)
+{
+	V mu1_sq = mu1*mu1;
+	V mu2_sq = mu2*mu2;
+	V mu1_mu2 = mu1*mu2;
+	V sigma1_sq = e11 - mu1_sq;
+	V sigma2_sq = e22 - mu2_sq;
+	V sigma12 = e12 - mu1_mu2;
+	V t1 = 2.0f*sigma12 + C2;
+	V t2 = sigma1_sq + sigma2_sq + C2;
+	cs = t1/t2;
+	ssim = (t1*(2.0f*mu1_mu2 + C1))/(t2*(mu1_sq + mu2_sq + C1));
+}
+
+void ssimRow(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, int n, double *ssim_sum, double *cs_sum)
+{
+	RowSum s_ssim, s_cs;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat m1, m2, v11, v22, v12, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim);
+		s_cs.add(cs);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 m1, m2, v11, v22, v12, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim);
+		s_cs.add(cs);
+	}
+	for (; j<n; j++) {
+		float ssim, cs;
+		ssimMaps(mu1[j], mu2[j], e11[j], e22[j], e12[j], C1, C2, ssim, cs);
+		s_ssim.addTail(ssim);
+		s_cs.addTail(cs);
+	}
+	*ssim_sum = s_ssim.value();
+	*cs_sum = s_cs.value();
+}
+
+void ssimRowMap(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, int n, int first, int size, double *ssim_sum, double *cs_sum, double *blocks, float *map)
+{
+	RowSum s_ssim, s_cs;
+	BlockRowSum s_blocks(first, size, blocks);
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat m1, m2, v11, v22, v12, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim);
+		s_cs.add(cs);
+		s_blocks.add(ssim, j);
+		if (map != NULL) store(map+j, ssim);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 m1, m2, v11, v22, v12, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim);
+		s_cs.add(cs);
+		s_blocks.add(ssim, j);
+		if (map != NULL) store(map+j, ssim);
+	}
+	for (; j<n; j++) {
+		float ssim, cs;
+		ssimMaps(mu1[j], mu2[j], e11[j], e22[j], e12[j], C1, C2, ssim, cs);
+		s_ssim.addTail(ssim);
+		s_cs.addTail(cs);
+		s_blocks.addTail(ssim, j);
+		if (map != NULL) map[j] = ssim;
+	}
+	*ssim_sum = s_ssim.value();
+	*cs_sum = s_cs.value();
+}
+
+void ssimRowWeighted(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float C1, float C2, const float *weights, int n, double *ssim_sum, double *cs_sum)
+{
+	RowSum s_ssim, s_cs;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		vfloat m1, m2, v11, v22, v12, vw, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		load(vw, weights+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim*vw);
+		s_cs.add(cs*vw);
+	}
+	for (; j+4<=n; j+=4) {
+		vfloat4 m1, m2, v11, v22, v12, vw, ssim, cs;
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		load(vw, weights+j);
+		ssimMaps(m1, m2, v11, v22, v12, C1, C2, ssim, cs);
+		s_ssim.add(ssim*vw);
+		s_cs.add(cs*vw);
+	}
+	for (; j<n; j++) {
+		float ssim, cs;
+		ssimMaps(mu1[j], mu2[j], e11[j], e22[j], e12[j], C1, C2, ssim, cs);
+		s_ssim.addTail(ssim*weights[j]);
+		s_cs.addTail(cs*weights[j]);
+	}
+	*ssim_sum = s_ssim.value();
+	*cs_sum = s_cs.value();
+}
+
+// Natural logarithm of positive finite values (Cephes logf, about 1 ulp):
+// x = m*2^e with m in [sqrt(0.5), sqrt(2)), log(x) = e*log(2) + log(m)
+inline vfloat vlog(const vfloat& x)
+{
+	vuint bits;
+	memcpy(&bits, &x, sizeof(bits));
+	vint e = __builtin_convertvector(bits >> 23, vint) - 127;
+	bits = (bits & 0x007fffffu) | 0x3f800000u;
+	vfloat m;
+	memcpy(&m, &bits, sizeof(m));
+
+	// m in [1, 2) to [sqrt(0.5), sqrt(2))
+	vint big = m > 1.41421356f;
+	m = big ? 0.5f*m : m;
+	e -= big;
+
+	vfloat f = m - 1.0f;
+	vfloat z = f*f;
+	vfloat y = 7.0376836292e-2f*f - 1.1514610310e-1f;
+	y = y*f + 1.1676998740e-1f;
+	y = y*f - 1.2420140846e-1f;
+	y = y*f + 1.4249322787e-1f;
+	y = y*f - 1.6668057665e-1f;
+	y = y*f + 2.0000714765e-1f;
+	y = y*f - 2.4999993993e-1f;
+	y = y*f + 3.3333331174e-1f;
+	y = y*f*z;
+
+	vfloat fe = __builtin_convertvector(e, vfloat);
+	y += -2.12194440e-4f*fe;
+	y += -0.5f*z;
+	return f + y + 0.693359375f*fe;
+}
+
+// Numerator and denominator terms of VIFp, the masks of the Matlab code
+// are replaced by selects:
+// sigma1_sq(sigma1_sq<0)=0; sigma2_sq(sigma2_sq<0)=0;
+// g=sigma12./(sigma1_sq+1e-10); sv_sq=sigma2_sq-g.*sigma12;
+// g(sigma1_sq<1e-10)=0; sv_sq(sigma1_sq<1e-10)=sigma2_sq(sigma1_sq<1e-10); sigma1_sq(sigma1_sq<1e-10)=0;
+// g(sigma2_sq<1e-10)=0; sv_sq(sigma2_sq<1e-10)=0;
+// sv_sq(g<0)=sigma2_sq(g<0); g(g<0)=0;
+// sv_sq(sv_sq<=1e-10)=1e-10;
+// num = log(1+g.^2.*sigma1_sq./(sv_sq+sigma_nsq)); den = log(1+sigma1_sq./sigma_nsq);
+inline void vifpTerms(const vfloat& mu1, const vfloat& mu2, const vfloat& e11, const vfloat& e22, const vfloat& e12, float sigma_nsq, vfloat& num, vfloat& den)
+{
+	const float EPSILON = 1e-10f;
+	const vfloat zero = {};
+
+	vfloat sigma1_sq = e11 - mu1*mu1;
+	vfloat sigma2_sq = e22 - mu2*mu2;
+	vfloat sigma12 = e12 - mu1*mu2;
+	sigma1_sq = sigma1_sq > 0.0f ? sigma1_sq : zero;
+	sigma2_sq = sigma2_sq > 0.0f ? sigma2_sq : zero;
+
+	vfloat g = sigma12/(sigma1_sq + EPSILON);
+	vfloat sv_sq = sigma2_sq - g*sigma12;
+
+	vint keep1 = sigma1_sq > EPSILON;
+	g = keep1 ? g : zero;
+	sv_sq = keep1 ? sv_sq : sigma2_sq;
+	sigma1_sq = keep1 ? sigma1_sq : zero;
+
+	vint keep2 = sigma2_sq > EPSILON;
+	g = keep2 ? g : zero;
+	sv_sq = keep2 ? sv_sq : zero;
+
+	vint positive = g > 0.0f;
+	sv_sq = positive ? sv_sq : sigma2_sq;
+	g = positive ? g : zero;
+
+	sv_sq = sv_sq > EPSILON ? sv_sq : zero + EPSILON;
+
+	num = vlog(g*g*sigma1_sq/(sv_sq + sigma_nsq) + 1.0f);
+	den = vlog(sigma1_sq/sigma_nsq + 1.0f);
+}
+
+void vifpRow(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float sigma_nsq, int n, double *num_sum, double *den_sum)
+{
+	RowSum s_num, s_den;
+	vfloat m1, m2, v11, v22, v12, num, den;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		vifpTerms(m1, m2, v11, v22, v12, sigma_nsq, num, den);
+		s_num.add(num);
+		s_den.add(den);
+	}
+	if (j < n) {
+		// Zero-padded last vector
+		float buf[5][W] = {{0.0f}};
+		for (int k=0; k<n-j; k++) {
+			buf[0][k] = mu1[j+k];
+			buf[1][k] = mu2[j+k];
+			buf[2][k] = e11[j+k];
+			buf[3][k] = e22[j+k];
+			buf[4][k] = e12[j+k];
+		}
+		load(m1, buf[0]);
+		load(m2, buf[1]);
+		load(v11, buf[2]);
+		load(v22, buf[3]);
+		load(v12, buf[4]);
+		vifpTerms(m1, m2, v11, v22, v12, sigma_nsq, num, den);
+		s_num.addLast(num, n-j);
+		s_den.addLast(den, n-j);
+	}
+	*num_sum = s_num.value();
+	*den_sum = s_den.value();
+}
+
+// Ratio of the numerator and denominator terms, 1 where the denominator is
+// 0 (no information in the original image)
+inline vfloat vifpRatio(const vfloat& num, const vfloat& den)
+{
+	const vfloat one = {};
+	return den > 0.0f ? num/den : one + 1.0f;
+}
+
+void vifpRowMap(const float *mu1, const float *mu2, const float *e11, const float *e22, const float *e12, float sigma_nsq, int n, double *num_sum, double *den_sum, float *map)
+{
+	RowSum s_num, s_den;
+	vfloat m1, m2, v11, v22, v12, num, den;
+	int j = 0;
+	for (; j+W<=n; j+=W) {
+		load(m1, mu1+j);
+		load(m2, mu2+j);
+		load(v11, e11+j);
+		load(v22, e22+j);
+		load(v12, e12+j);
+		vifpTerms(m1, m2, v11, v22, v12, sigma_nsq, num, den);
+		s_num.add(num);
+		s_den.add(den);
+		store(map+j, vifpRatio(num, den));
+	}
+	if (j < n) {
+		// Zero-padded last vector
+		float buf[5][W] = {{0.0f}};
+		for (int k=0; k<n-j; k++) {
+			buf[0][k] = mu1[j+k];
+			buf[1][k] = mu2[j+k];
+			buf[2][k] = e11[j+k];
+			buf[3][k] = e22[j+k];
+			buf[4][k] = e12[j+k];
+		}
+		load(m1, buf[0]);
+		load(m2, buf[1]);
+		load(v11, buf[2]);
+		load(v22, buf[3]);
+		load(v12, buf[4]);
+		vifpTerms(m1, m2, v11, v22, v12, sigma_nsq, num, den);
+		s_num.addLast(num, n-j);
+		s_den.addLast(den, n-j);
+		store(buf[0], vifpRatio(num, den));
+		for (int k=0; k<n-j; k++) {
+			map[j+k] = buf[0][k];
+		}
+	}
+	*num_sum = s_num.value();
+	*den_sum = s_den.value();
+}
+
+void convolveColumn(const float *src, size_t step, const float *kernel, int ksize, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vfloat v, s;
+		load(v, src+x);
+		s = kernel[0]*v;
+		for (int t=1; t<ksize; t++) {
+			load(v, src+static_cast<size_t>(t)*step+x);
+			s += kernel[t]*v;
+		}
+		store(dst+x, s);
+	}
+	for (; x<n; x++) {
+		float s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[static_cast<size_t>(t)*step+static_cast<size_t>(x)];
+		}
+		dst[x] = s;
+	}
+}
+
+void convolveColumn8u(const unsigned char *src, size_t step, const float *kernel, int ksize, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vfloat s = kernel[0]*__builtin_convertvector(widen(src+x), vfloat);
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*__builtin_convertvector(widen(src+static_cast<size_t>(t)*step+x), vfloat);
+		}
+		store(dst+x, s);
+	}
+	for (; x<n; x++) {
+		float s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[static_cast<size_t>(t)*step+static_cast<size_t>(x)];
+		}
+		dst[x] = s;
+	}
+}
+
+void convolveRow(const float *src, const float *kernel, int ksize, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vfloat v, s;
+		load(v, src+x);
+		s = kernel[0]*v;
+		for (int t=1; t<ksize; t++) {
+			load(v, src+x+t);
+			s += kernel[t]*v;
+		}
+		store(dst+x, s);
+	}
+	for (; x<n; x++) {
+		float s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[x+t];
+		}
+		dst[x] = s;
+	}
+}
+
+void convolveRowAdd(const float *src, const float *kernel, int ksize, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vfloat v, s;
+		load(v, src+x);
+		s = kernel[0]*v;
+		for (int t=1; t<ksize; t++) {
+			load(v, src+x+t);
+			s += kernel[t]*v;
+		}
+		load(v, dst+x);
+		store(dst+x, v + s);
+	}
+	for (; x<n; x++) {
+		float s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[x+t];
+		}
+		dst[x] += s;
+	}
+}
+
+// Strided loops are left to the auto-vectorizer of each instruction set
+void deinterleave(const float *src, float *even, float *odd, int n)
+{
+	for (int x=0; x<n/2; x++) {
+		even[x] = src[2*x];
+		odd[x] = src[2*x+1];
+	}
+	if (n % 2 != 0) {
+		even[n/2] = src[n-1];
+	}
+}
+
+// Same as cv::resize with INTER_LINEAR (or INTER_AREA) for a factor of 2
+void downsample2x2(const float *row0, const float *row1, float *dst, int n)
+{
+	for (int x=0; x<n/2; x++) {
+		dst[x] = (row0[2*x] + row0[2*x+1] + row1[2*x] + row1[2*x+1])*0.25f;
+	}
+	if (n % 2 != 0) {
+		dst[n/2] = (row0[n-1] + row0[n-1] + row1[n-1] + row1[n-1])*0.25f;
+	}
+}
+
+// Integer sums are exact, so this is the same as downsample2x2 on the widened rows
+void downsample2x2_8u(const unsigned char *row0, const unsigned char *row1, float *dst, int n)
+{
+	for (int x=0; x<n/2; x++) {
+		dst[x] = static_cast<float>(row0[2*x] + row0[2*x+1] + row1[2*x] + row1[2*x+1])*0.25f;
+	}
+	if (n % 2 != 0) {
+		dst[n/2] = static_cast<float>(row0[n-1] + row0[n-1] + row1[n-1] + row1[n-1])*0.25f;
+	}
+}
+
+void convolveColumnFixed(const unsigned char *src, size_t step, const int *kernel, int ksize, int shift, unsigned short *dst, int n)
+{
+	const int round = 1 << (shift-1);
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vint s = kernel[0]*widen(src+x);
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*widen(src+static_cast<size_t>(t)*step+x);
+		}
+		narrow(dst+x, (s + round) >> shift);
+	}
+	for (; x<n; x++) {
+		int s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[static_cast<size_t>(t)*step+static_cast<size_t>(x)];
+		}
+		dst[x] = static_cast<unsigned short>((s + round) >> shift);
+	}
+}
+
+void convolveRowFixed(const unsigned short *src, const int *kernel, int ksize, float scale, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vint s = kernel[0]*widen(src+x);
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*widen(src+x+t);
+		}
+		store(dst+x, scale*__builtin_convertvector(s, vfloat));
+	}
+	for (; x<n; x++) {
+		int s = kernel[0]*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += kernel[t]*src[x+t];
+		}
+		dst[x] = scale*static_cast<float>(s);
+	}
+}
+
+// a*a, b*b and a*b fit in 16 bits and their sums with coefficients
+// adding up to at most 1 << 15 in 31 bits, so all sums are exact
+void momentsColumnFixed(const unsigned char *a, const unsigned char *b, size_t step, const int *kernel, int ksize, int shift, unsigned short *mu1, unsigned short *mu2, unsigned int *e11, unsigned int *e22, unsigned int *e12, int n)
+{
+	const int round = 1 << (shift-1);
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vint s1 = {0}, s2 = {0}, s11 = {0}, s22 = {0}, s12 = {0};
+		for (int t=0; t<ksize; t++) {
+			vint va = widen(a+static_cast<size_t>(t)*step+x);
+			vint vb = widen(b+static_cast<size_t>(t)*step+x);
+			s1 += kernel[t]*va;
+			s2 += kernel[t]*vb;
+			s11 += kernel[t]*(va*va);
+			s22 += kernel[t]*(vb*vb);
+			s12 += kernel[t]*(va*vb);
+		}
+		narrow(mu1+x, (s1 + round) >> shift);
+		narrow(mu2+x, (s2 + round) >> shift);
+		store(e11+x, __builtin_convertvector((s11 + round) >> shift, vuint));
+		store(e22+x, __builtin_convertvector((s22 + round) >> shift, vuint));
+		store(e12+x, __builtin_convertvector((s12 + round) >> shift, vuint));
+	}
+	for (; x<n; x++) {
+		int s1 = 0, s2 = 0, s11 = 0, s22 = 0, s12 = 0;
+		for (int t=0; t<ksize; t++) {
+			size_t i = static_cast<size_t>(t)*step+static_cast<size_t>(x);
+			int va = a[i];
+			int vb = b[i];
+			s1 += kernel[t]*va;
+			s2 += kernel[t]*vb;
+			s11 += kernel[t]*(va*va);
+			s22 += kernel[t]*(vb*vb);
+			s12 += kernel[t]*(va*vb);
+		}
+		mu1[x] = static_cast<unsigned short>((s1 + round) >> shift);
+		mu2[x] = static_cast<unsigned short>((s2 + round) >> shift);
+		e11[x] = static_cast<unsigned int>((s11 + round) >> shift);
+		e22[x] = static_cast<unsigned int>((s22 + round) >> shift);
+		e12[x] = static_cast<unsigned int>((s12 + round) >> shift);
+	}
+}
+
+void convolveRowFixed32(const unsigned int *src, const int *kernel, int ksize, float scale, float *dst, int n)
+{
+	int x = 0;
+	for (; x+W<=n; x+=W) {
+		vuint v;
+		load(v, src+x);
+		vuint s = static_cast<unsigned int>(kernel[0])*v;
+		for (int t=1; t<ksize; t++) {
+			load(v, src+x+t);
+			s += static_cast<unsigned int>(kernel[t])*v;
+		}
+		store(dst+x, scale*__builtin_convertvector(s, vfloat));
+	}
+	for (; x<n; x++) {
+		unsigned int s = static_cast<unsigned int>(kernel[0])*src[x];
+		for (int t=1; t<ksize; t++) {
+			s += static_cast<unsigned int>(kernel[t])*src[x+t];
+		}
+		dst[x] = scale*static_cast<float>(s);
+	}
+}
+
+// dst = C*src*C', one row of eight coefficients per vector
+void dct8x8(const float *src, size_t step, float *dst)
+{
+	vfloat8 x[8], t[8], ct[8];
+
+	for (int i=0; i<8; i++) {
+		load(x[i], src+static_cast<size_t>(i)*step);
+		// Row j of C' is column j of C
+		for (int v=0; v<8; v++) {
+			ct[i][v] = DCT[v][i];
+		}
+	}
+
+	// t = C*src
+	for (int u=0; u<8; u++) {
+		t[u] = DCT[u][0]*x[0];
+		for (int i=1; i<8; i++) {
+			t[u] += DCT[u][i]*x[i];
+		}
+	}
+
+	// dst = t*C'
+	for (int u=0; u<8; u++) {
+		vfloat8 y = t[u][0]*ct[0];
+		for (int j=1; j<8; j++) {
+			y += t[u][j]*ct[j];
+		}
+		store(dst+8*u, y);
+	}
+}
+
+// Byte shuffles are left to the auto-vectorizer of each instruction set
+// (GCC -O3 vectorizes the five loops below with 16-byte vectors for the
+// baseline and SSE4.2 and 32-byte ones for AVX2 and AVX-512, see
+// -fopt-info-vec-optimized), 16-bit samples are read byte by byte to be
+// independent of endianness
+inline unsigned char round16to8(const unsigned char *p)
+{
+	// (x + 128) >> 8, saturated
+	int x = (p[0] | (p[1] << 8)) + 128;
+	return static_cast<unsigned char>(x > 0xffff ? 255 : x >> 8);
+}
+
+void deinterleave8u(const unsigned char *src, unsigned char *even, unsigned char *odd, int n)
+{
+	for (int x=0; x<n; x++) {
+		even[x] = src[2*x];
+		odd[x] = src[2*x+1];
+	}
+}
+
+void deinterleave16to8u(const unsigned char *src, unsigned char *even, unsigned char *odd, int n)
+{
+	for (int x=0; x<n; x++) {
+		even[x] = round16to8(src+4*x);
+		odd[x] = round16to8(src+4*x+2);
+	}
+}
+
+void narrow16to8u(const unsigned char *src, unsigned char *dst, int n)
+{
+	for (int x=0; x<2*n; x++) {
+		dst[x] = round16to8(src+2*x);
+	}
+}
+
+void unpackYUYV(const unsigned char *src, unsigned char *y, unsigned char *u, unsigned char *v, int n)
+{
+	for (int x=0; x<n; x++) {
+		y[2*x] = src[4*x];
+		u[x] = src[4*x+1];
+		y[2*x+1] = src[4*x+2];
+		v[x] = src[4*x+3];
+	}
+}
+
+void unpackUYVY(const unsigned char *src, unsigned char *y, unsigned char *u, unsigned char *v, int n)
+{
+	for (int x=0; x<n; x++) {
+		u[x] = src[4*x];
+		y[2*x] = src[4*x+1];
+		v[x] = src[4*x+2];
+		y[2*x+1] = src[4*x+3];
+	}
+}
+
+}
+
+extern const KernelTable KERNEL_TABLE;
+const KernelTable KERNEL_TABLE = {
+	sumRow,
+	sumSquaredDiff,
+	sumSquaredDiff8u,
+	sumSquaredDiffWeighted,
+	sumSquaredDiffWeighted8u,
+	moments,
+	moments8u,
+	ssimRow,
+	ssimRowMap,
+	ssimRowWeighted,
+	vifpRow,
+	vifpRowMap,
+	convolveColumn,
+	convolveColumn8u,
+	convolveRow,
+	convolveRowAdd,
+	deinterleave,
+	downsample2x2,
+	downsample2x2_8u,
+	convolveColumnFixed,
+	convolveRowFixed,
+	momentsColumnFixed,
+	convolveRowFixed32,
+	dct8x8,
+	deinterleave8u,
+	deinterleave16to8u,
+	narrow16to8u,
+	unpackYUYV,
+	unpackUYVY
+};
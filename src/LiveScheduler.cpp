@@ -0,0 +1,163 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "LiveScheduler.hpp"
+
+const int LiveScheduler::MAX_INTERVAL;
+const int LiveScheduler::WINDOW;
+
+// Metrics computed for every frame: PSNR only (EWPSNR builds a weight map
+// of the whole frame, one Gaussian per gaze point and pixel)
+static const bool CHEAP_METRIC[METRIC_SIZE] = {true, false, false, false, false, false, false};
+
+static long long nowNs()
+{
+	return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+LiveScheduler::LiveScheduler(double f, double d, const bool sel[METRIC_SIZE], const std::string& path)
+{
+	fps = f;
+	deadline = d;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		selected[m] = sel[m];
+		computed[m] = 0;
+	}
+	log = fopen(path.c_str(), "w");
+	if (log == NULL) {
+		fprintf(stderr, "Cannot open output file %s\n", path.c_str());
+	}
+	else {
+		fprintf(log, "frame,lag_ms,metrics\n");
+	}
+	start_ns = nowNs();
+	interval = 1;
+	last_planned = -1;
+	last_change = -1;
+	window_frames = 0;
+	window_lag = 0.0;
+	previous_lag = 0.0;
+	calm = 0;
+	frames = 0;
+	late = 0;
+	lag_sum = 0.0;
+	lag_max = 0.0;
+	max_interval = 1;
+}
+
+LiveScheduler::~LiveScheduler()
+{
+	if (log != NULL) {
+		fclose(log);
+	}
+}
+
+double LiveScheduler::now() const
+{
+	return static_cast<double>(nowNs() - start_ns)*1e-9;
+}
+
+void LiveScheduler::start()
+{
+	start_ns = nowNs();
+}
+
+void LiveScheduler::waitDue(int index) const
+{
+	double wait = index/fps - now();
+	if (wait > 0.0) {
+		std::this_thread::sleep_for(std::chrono::nanoseconds(static_cast<long long>(wait*1e9)));
+	}
+}
+
+void LiveScheduler::plan(int index, bool active[METRIC_SIZE])
+{
+	last_planned = index;
+	int n = interval;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		active[m] = selected[m] && (CHEAP_METRIC[m] || index % n == 0);
+	}
+}
+
+void LiveScheduler::done(int index, int frame, const bool active[METRIC_SIZE])
+{
+	double lag = now() - index/fps;
+	frames++;
+	lag_sum += lag;
+	if (lag > lag_max) lag_max = lag;
+	if (lag > deadline) late++;
+
+	if (log != NULL) fprintf(log, "%d,%.3f,", frame, 1000*lag);
+	const char *separator = "";
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (!active[m]) continue;
+		computed[m]++;
+		if (log != NULL) fprintf(log, "%s%s", separator, METRIC_NAME[m]);
+		separator = "+";
+	}
+	if (log != NULL) fprintf(log, "\n");
+
+	// Frames planned before the last change do not tell its effect
+	if (index <= last_change) return;
+	int n = interval;
+	window_frames++;
+	window_lag += lag;
+	if (window_frames < std::max(WINDOW, 2*n)) return;
+
+	double mean_lag = window_lag/window_frames;
+	if (mean_lag > deadline) {
+		calm = 0;
+		if (n < MAX_INTERVAL && mean_lag >= previous_lag) n *= 2;
+	}
+	else if (mean_lag <= deadline/2) {
+		calm += window_frames;
+		if (calm >= fps && n > 1) n /= 2;
+	}
+	else {
+		calm = 0;
+	}
+	previous_lag = mean_lag;
+	window_frames = 0;
+	window_lag = 0.0;
+	if (n != interval) {
+		interval = n;
+		last_change = last_planned;
+		calm = 0;
+		if (n > max_interval) max_interval = n;
+		printf("Frame %d: lag %.1fms, expensive metrics computed every %d frame(s)\n", frame, 1000*mean_lag, n);
+	}
+}
+
+void LiveScheduler::report(FILE *out) const
+{
+	fprintf(out, "Live (%.3g fps, deadline %.1fms): %d frames, %d late, lag mean %.1fms, max %.1fms\n",
+			fps, 1000*deadline, frames, late, frames > 0 ? 1000*lag_sum/frames : 0.0, 1000*lag_max);
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (selected[m]) fprintf(out, "  %-8s %d frames\n", METRIC_NAME[m], computed[m]);
+	}
+	fprintf(out, "  expensive metrics computed every %d frame(s) at most\n", max_interval);
+}
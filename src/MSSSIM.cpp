@@ -33,48 +33,72 @@
 //   on Signals, Systems and Computers, November 2003, vol. 2, pp. 1398–1402.
 //
 
+#include <cmath>
+#include <limits>
 #include "MSSSIM.hpp"
+#include "ThreadPool.hpp"
 
 const double MSSSIM::WEIGHT[] = {0.0448, 0.2856, 0.3001, 0.2363, 0.1333};
 
-MSSSIM::MSSSIM(int h, int w) : SSIM(h, w)
+MSSSIM::MSSSIM(int h, int w) : SSIM(h, w), original_pyramid(PYRAMID_MSSSIM), processed_pyramid(PYRAMID_MSSSIM), weight_pyramid(PYRAMID_MSSSIM)
 {
 }
 
 float MSSSIM::compute(const cv::Mat& original, const cv::Mat& processed)
+{
+	// filtered_im1 = filter2(downsample_filter, im1, 'valid');
+	// im1 = filtered_im1(1:2:M-1, 1:2:N-1);
+	original_pyramid.build(original);
+	// filtered_im2 = filter2(downsample_filter, im2, 'valid');
+	// im2 = filtered_im2(1:2:M-1, 1:2:N-1);
+	processed_pyramid.build(processed);
+
+	return compute(original_pyramid, processed_pyramid);
+}
+
+// Rectangle out of which the weights of level l are zero, from the one of
+// level 0: a weight of level l is the average of at most 2x2 weights of
+// level l-1, the last row and column being repeated
+static cv::Rect levelBounds(const cv::Rect& bounds, int l)
+{
+	int x0 = bounds.x, y0 = bounds.y;
+	int x1 = bounds.x + bounds.width, y1 = bounds.y + bounds.height;
+	for (int k=0; k<l; k++) {
+		x0 /= 2;
+		y0 /= 2;
+		x1 = (x1+1)/2;
+		y1 = (y1+1)/2;
+	}
+	return cv::Rect(x0, y0, x1-x0, y1-y0);
+}
+
+float MSSSIM::compute(const Pyramid& original, const Pyramid& processed)
 {
 	double mssim[NLEVS];
 	double mcs[NLEVS];
+	bool weighted = !pixel_weights.empty();
+	if (weighted && weight_bounds.area() <= 0) {
+		// A frame without weight has no score
+		ssim = msssim = std::numeric_limits<double>::quiet_NaN();
+		return float(msssim);
+	}
+	if (weighted) weight_pyramid.build(pixel_weights);
 
-	cv::Mat im1[NLEVS];
-	cv::Mat im2[NLEVS];
-	
-	int w = original.cols;
-	int h = original.rows;
-	
-	original.copyTo(im1[0]);
-	processed.copyTo(im2[0]);
-	
-	for (int l=0; l<NLEVS; l++) {
-		// [mssim_array(l) ssim_map_array{l} mcs_array(l) cs_map_array{l}] = ssim_index_new(im1, im2, K, window);
-		cv::Scalar res = SSIM::computeSSIM(im1[l], im2[l]);
-		mssim[l] = res.val[0];
-		mcs[l] = res.val[1];
-
-		if (l < NLEVS-1) {
-			w /= 2;
-			h /= 2;
-			im1[l+1] = cv::Mat(h,w,CV_32F);
-			im2[l+1] = cv::Mat(h,w,CV_32F);
-			
-			// filtered_im1 = filter2(downsample_filter, im1, 'valid');
-			// im1 = filtered_im1(1:2:M-1, 1:2:N-1);
-			cv::resize(im1[l], im1[l+1], cv::Size(w,h), 0, 0, cv::INTER_LINEAR);
-			// filtered_im2 = filter2(downsample_filter, im2, 'valid');
-			// im2 = filtered_im2(1:2:M-1, 1:2:N-1);
-			cv::resize(im2[l], im2[l+1], cv::Size(w,h), 0, 0, cv::INTER_LINEAR);
+	// The levels are independent once the pyramid is built
+	ThreadPool::instance().parallelFor(NLEVS, 1, [&](int begin, int end) {
+		for (int l=begin; l<end; l++) {
+			// [mssim_array(l) ssim_map_array{l} mcs_array(l) cs_map_array{l}] = ssim_index_new(im1, im2, K, window);
+			cv::Scalar res = weighted ? SSIM::computeWeightedSSIM(original.getLevel(l), processed.getLevel(l), false, weight_pyramid.getLevel(l), levelBounds(weight_bounds, l))
+				: SSIM::computeSSIM(original.getLevel(l), processed.getLevel(l), false, l == 0);
+			// A coarser level may have no weight at the centres of its windows
+			// while the first has some, it is not weighted then
+			if (weighted && l > 0 && std::isnan(res.val[0])) {
+				res = SSIM::computeSSIM(original.getLevel(l), processed.getLevel(l), false, false);
+			}
+			mssim[l] = res.val[0];
+			mcs[l] = res.val[1];
 		}
-	}
+	});
 
 	ssim = mssim[0];
 
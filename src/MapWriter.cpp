@@ -0,0 +1,251 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+#include "MapWriter.hpp"
+#include "Pyramid.hpp"
+#include "ThreadPool.hpp"
+
+const int MapWriter::DEFAULT_DEPTH;
+
+static const char MAGIC[8] = {'V', 'Q', 'M', 'T', 'M', 'A', 'P', 'S'};
+static const char END_MAGIC[8] = {'V', 'Q', 'M', 'T', 'M', 'E', 'N', 'D'};
+static const unsigned int VERSION = 1;
+
+// Names of the files and ranges of the quantized values of each metric
+static const char *MAP_NAME[METRIC_SIZE] = {NULL, "ssim", NULL, "vifp", NULL, NULL, NULL};
+static const float MAP_MIN[METRIC_SIZE] = {0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+static const float MAP_MAX[METRIC_SIZE] = {0.0f, 1.0f, 0.0f, 2.0f, 0.0f, 0.0f, 0.0f};
+
+static void putU32(std::vector<unsigned char>& buffer, unsigned int value)
+{
+	for (int b=0; b<4; b++) {
+		buffer.push_back(static_cast<unsigned char>(value >> (8*b)));
+	}
+}
+
+static void putU64(std::vector<unsigned char>& buffer, unsigned long long value)
+{
+	for (int b=0; b<8; b++) {
+		buffer.push_back(static_cast<unsigned char>(value >> (8*b)));
+	}
+}
+
+static void putFloat(std::vector<unsigned char>& buffer, float value)
+{
+	unsigned int u;
+	memcpy(&u, &value, sizeof(u));
+	putU32(buffer, u);
+}
+
+// Round (x-min)*scale to the nearest integer in [0, qmax]
+template<typename T> static void quantize(const float *src, T *dst, int n, float min, float scale, float qmax)
+{
+	for (int j=0; j<n; j++) {
+		float q = (src[j] - min)*scale + 0.5f;
+		q = q > 0.0f ? q : 0.0f;
+		q = q < qmax ? q : qmax;
+		dst[j] = static_cast<T>(q);
+	}
+}
+
+MapWriter::MapWriter(const std::string& prefix, int height, int width, int b, const bool sel[METRIC_SIZE], int nworkers, int depth)
+{
+	bits = b;
+	closed = false;
+	pixels = 0;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		selected[m] = sel[m] && METRIC_MAPS[m];
+		Output& out = output[m];
+		out.file = NULL;
+		out.border = m == METRIC_SSIM ? 5 : (Pyramid::VIFP_WINDOW[0]-1)/2;
+		out.min = MAP_MIN[m];
+		out.max = MAP_MAX[m];
+		out.bytes = 0;
+		if (!selected[m]) continue;
+
+		std::string path = prefix + "_" + MAP_NAME[m] + "_map.bin";
+		out.file = fopen(path.c_str(), "wb");
+		if (out.file == NULL) {
+			fprintf(stderr, "Cannot open output file %s\n", path.c_str());
+			selected[m] = false;
+			continue;
+		}
+		std::vector<unsigned char> header(MAGIC, MAGIC+sizeof(MAGIC));
+		putU32(header, VERSION);
+		putU32(header, static_cast<unsigned int>(width - 2*out.border));
+		putU32(header, static_cast<unsigned int>(height - 2*out.border));
+		putU32(header, static_cast<unsigned int>(out.border));
+		putU32(header, static_cast<unsigned int>(bits));
+		putFloat(header, out.min);
+		putFloat(header, out.max);
+		fwrite(header.data(), 1, header.size(), out.file);
+		out.bytes = static_cast<long long>(header.size());
+	}
+
+	// A frame being filled or compressed by each thread, and one more queued
+	if (nworkers <= 0) nworkers = ThreadPool::instance().getNumThreads();
+	depth = std::max(depth, 2*nworkers);
+	free_frames = new FrameQueue(static_cast<size_t>(depth));
+	queued = new FrameQueue(static_cast<size_t>(depth));
+	for (int i=0; i<depth; i++) {
+		frames.push_back(new Frame());
+		free_frames->push(frames.back());
+	}
+	for (int w=0; w<nworkers; w++) {
+		workers.push_back(std::thread(&MapWriter::compressFrames, this));
+	}
+}
+
+MapWriter::~MapWriter()
+{
+	close();
+	delete free_frames;
+	delete queued;
+	for (size_t i=0; i<frames.size(); i++) {
+		delete frames[i];
+	}
+}
+
+void MapWriter::add(int frame, const MetricSet& metrics)
+{
+	Frame *f;
+	if (!free_frames->pop(f)) return;
+	f->frame = frame;
+	float qmax = static_cast<float>((1 << bits) - 1);
+	for (int m=0; m<METRIC_SIZE; m++) {
+		cv::Mat map = selected[m] ? metrics.getMap(m) : cv::Mat();
+		if (map.empty()) {
+			f->map[m].release();
+			continue;
+		}
+		const Output& out = output[m];
+		float scale = qmax/(out.max - out.min);
+		f->map[m].create(map.rows, map.cols, bits > 8 ? CV_16U : CV_8U);
+		for (int i=0; i<map.rows; i++) {
+			if (bits > 8) {
+				quantize(map.ptr<float>(i), f->map[m].ptr<unsigned short>(i), map.cols, out.min, scale, qmax);
+			}
+			else {
+				quantize(map.ptr<float>(i), f->map[m].ptr<uchar>(i), map.cols, out.min, scale, qmax);
+			}
+		}
+	}
+	queued->push(f);
+}
+
+// Replace the elements of a row by their differences with the previous ones,
+// modulo 2^bits, stored little-endian
+template<typename T> static void delta(const T *src, int n, unsigned char *dst)
+{
+	T previous = 0;
+	for (int j=0; j<n; j++) {
+		T d = static_cast<T>(src[j] - previous);
+		previous = src[j];
+		for (size_t b=0; b<sizeof(T); b++) {
+			*dst++ = static_cast<unsigned char>(d >> (8*b));
+		}
+	}
+}
+
+void MapWriter::compressFrames()
+{
+	std::vector<unsigned char> filtered, compressed;
+	std::vector<unsigned char> record;
+	Frame *f;
+	while (queued->pop(f)) {
+		for (int m=0; m<METRIC_SIZE; m++) {
+			const cv::Mat& map = f->map[m];
+			if (map.empty()) continue;
+			Output& out = output[m];
+			size_t row_bytes = static_cast<size_t>(map.cols)*map.elemSize();
+			filtered.resize(static_cast<size_t>(map.rows)*row_bytes);
+			for (int i=0; i<map.rows; i++) {
+				unsigned char *dst = &filtered[static_cast<size_t>(i)*row_bytes];
+				if (bits > 8) {
+					delta(map.ptr<unsigned short>(i), map.cols, dst);
+				}
+				else {
+					delta(map.ptr<uchar>(i), map.cols, dst);
+				}
+			}
+			uLongf size = compressBound(filtered.size());
+			compressed.resize(size);
+			if (compress2(compressed.data(), &size, filtered.data(), filtered.size(), Z_BEST_SPEED) != Z_OK) {
+				fprintf(stderr, "Cannot compress the %s map of frame %d\n", MAP_NAME[m], f->frame);
+				continue;
+			}
+			record.clear();
+			putU32(record, static_cast<unsigned int>(f->frame));
+			putU32(record, static_cast<unsigned int>(size));
+			std::lock_guard<std::mutex> guard(write_lock);
+			out.index.push_back(std::make_pair(f->frame, out.bytes));
+			fwrite(record.data(), 1, record.size(), out.file);
+			fwrite(compressed.data(), 1, size, out.file);
+			out.bytes += static_cast<long long>(record.size() + size);
+			pixels += static_cast<long long>(map.total());
+		}
+		free_frames->push(f);
+	}
+}
+
+void MapWriter::close()
+{
+	if (closed) return;
+	closed = true;
+	queued->close();
+	for (size_t w=0; w<workers.size(); w++) {
+		workers[w].join();
+	}
+
+	for (int m=0; m<METRIC_SIZE; m++) {
+		Output& out = output[m];
+		if (out.file == NULL) continue;
+		std::vector<unsigned char> index;
+		putU32(index, static_cast<unsigned int>(out.index.size()));
+		for (size_t i=0; i<out.index.size(); i++) {
+			putU32(index, static_cast<unsigned int>(out.index[i].first));
+			putU64(index, static_cast<unsigned long long>(out.index[i].second));
+		}
+		putU64(index, static_cast<unsigned long long>(out.bytes));
+		index.insert(index.end(), END_MAGIC, END_MAGIC+sizeof(END_MAGIC));
+		fwrite(index.data(), 1, index.size(), out.file);
+		fclose(out.file);
+		out.file = NULL;
+	}
+}
+
+void MapWriter::report(FILE *out) const
+{
+	long long bytes = 0;
+	size_t maps = 0;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		bytes += output[m].bytes;
+		maps += output[m].index.size();
+	}
+	fprintf(out, "Maps: %zu, %.1f MB (%.2f bits per element), compute threads waited %.3fs for the compression\n",
+			maps, static_cast<double>(bytes)/1e6, pixels > 0 ? 8.0*static_cast<double>(bytes)/static_cast<double>(pixels) : 0.0, free_frames->emptyTime());
+}
@@ -23,11 +23,17 @@
 //
 
 #include "Metric.hpp"
+#include "GaussianFilter.hpp"
+#include "ThreadPool.hpp"
+
+// Minimum number of output rows per band
+static const int MIN_BAND_HEIGHT = 16;
 
 Metric::Metric(int h, int w)
 {
 	height = h;
 	width = w;
+	setBlockSize(0);
 }
 
 Metric::~Metric()
@@ -37,8 +43,26 @@ Metric::~Metric()
 
 void Metric::applyGaussianBlur(const cv::Mat& src, cv::Mat& dst, int ksize, double sigma)
 {
-	int invalid = (ksize-1)/2;
-	cv::Mat tmp(src.rows, src.cols, CV_32F);
-	cv::GaussianBlur(src, tmp, cv::Size(ksize,ksize), sigma);
-	tmp(cv::Range(invalid, tmp.rows-invalid), cv::Range(invalid, tmp.cols-invalid)).copyTo(dst);
+	GaussianFilter::get(ksize, sigma).apply(src, dst);
+}
+
+void Metric::setBlockSize(int size)
+{
+	block_size = size;
+	block_cols = size > 0 ? (width + size - 1) / size : 0;
+	block_rows = size > 0 ? (height + size - 1) / size : 0;
+}
+
+void Metric::setWeights(const cv::Mat& weights, const cv::Rect& bounds)
+{
+	pixel_weights = weights;
+	weight_bounds = bounds;
+}
+
+int Metric::bandHeight(int rows)
+{
+	// About four bands per thread for load balancing
+	int nbands = 4*ThreadPool::instance().getNumThreads();
+	int band = (rows + nbands - 1) / nbands;
+	return band < MIN_BAND_HEIGHT ? MIN_BAND_HEIGHT : band;
 }
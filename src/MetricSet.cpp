@@ -0,0 +1,260 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <algorithm>
+#include <limits>
+#include "MetricSet.hpp"
+
+const char *METRIC_NAME[METRIC_SIZE] = {"PSNR", "SSIM", "MSSSIM", "VIFP", "PSNRHVS", "PSNRHVSM", "EWPSNR"};
+const bool METRIC_BLOCKS[METRIC_SIZE] = {true, true, false, false, true, true, false};
+const bool METRIC_MAPS[METRIC_SIZE] = {false, true, false, true, false, false, false};
+const bool METRIC_WEIGHTS[METRIC_SIZE] = {true, true, true, false, true, true, false};
+
+MetricSet::MetricSet(int height, int width, const bool sel[METRIC_SIZE], bool ssim_fixed, const char *original_file, PerfCounters *const *p) : graph(ThreadPool::instance())
+{
+	for (int m=0; m<METRIC_SIZE; m++) {
+		selected[m] = sel[m];
+	}
+	perf = p;
+	rows = height;
+	cols = width;
+	npixels = static_cast<long long>(height)*width;
+	nblocks = 0;
+	original_frame = NULL;
+	processed_frame = NULL;
+	frame_no = 0;
+	result = NULL;
+	active = NULL;
+
+	psnr   = new PSNR(height, width);
+	ssim   = new SSIM(height, width);
+	msssim = new MSSSIM(height, width);
+	vifp   = new VIFP(height, width);
+	phvs   = new PSNRHVS(height, width);
+	ewpsnr = new EWPSNR(height, width);
+
+	for (int t=0; t<PYRAMID_SIZE; t++) {
+		original_pyramid[t] = new Pyramid(static_cast<PyramidType>(t));
+		processed_pyramid[t] = new Pyramid(static_cast<PyramidType>(t));
+	}
+
+	setOriginal(original_file);
+
+	// Compute PSNR
+	if (selected[METRIC_PSNR]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_PSNR)) return;
+			PerfScope scope(counters(METRIC_PSNR), npixels);
+			result[METRIC_PSNR] = psnr->compute(*original_frame, *processed_frame);
+		});
+	}
+
+	// Compute EWPSNR
+	if (selected[METRIC_EWPSNR]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_EWPSNR)) return;
+			PerfScope scope(counters(METRIC_EWPSNR), npixels);
+			ewpsnr->set_frame_no(static_cast<unsigned int>(frame_no));
+			result[METRIC_EWPSNR] = ewpsnr->compute(*original_frame, *processed_frame);
+		});
+	}
+
+	// Compute SSIM and MS-SSIM
+	if (selected[METRIC_SSIM] && !selected[METRIC_MSSSIM] && ssim_fixed) {
+		graph.add([this]() {
+			if (!isActive(METRIC_SSIM)) return;
+			PerfScope scope(counters(METRIC_SSIM), npixels);
+			result[METRIC_SSIM] = ssim->computeFixed(*original_frame, *processed_frame);
+		});
+	}
+	else if (selected[METRIC_SSIM] && !selected[METRIC_MSSSIM]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_SSIM)) return;
+			PerfScope scope(counters(METRIC_SSIM), npixels);
+			result[METRIC_SSIM] = ssim->compute(*original_frame, *processed_frame);
+		});
+	}
+	if (selected[METRIC_MSSSIM]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_MSSSIM)) return;
+			PerfScope scope(counters(METRIC_MSSSIM), npixels);
+			msssim->compute(*original_pyramid[PYRAMID_MSSSIM], *processed_pyramid[PYRAMID_MSSSIM]);
+			if (selected[METRIC_SSIM]) {
+				result[METRIC_SSIM] = msssim->getSSIM();
+			}
+			result[METRIC_MSSSIM] = msssim->getMSSSIM();
+		}, addPyramidTasks(PYRAMID_MSSSIM, METRIC_MSSSIM));
+	}
+
+	// Compute VIFp
+	if (selected[METRIC_VIFP]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_VIFP)) return;
+			PerfScope scope(counters(METRIC_VIFP), npixels);
+			result[METRIC_VIFP] = vifp->compute(*original_pyramid[PYRAMID_VIFP], *processed_pyramid[PYRAMID_VIFP]);
+		}, addPyramidTasks(PYRAMID_VIFP, METRIC_VIFP));
+	}
+
+	// Compute PSNR-HVS and PSNR-HVS-M
+	if (selected[METRIC_PSNRHVS] || selected[METRIC_PSNRHVSM]) {
+		graph.add([this]() {
+			if (!isActive(METRIC_PSNRHVS) && !isActive(METRIC_PSNRHVSM)) return;
+			PerfScope scope(counters(METRIC_PSNRHVS), npixels);
+			phvs->compute(*original_frame, *processed_frame);
+			if (selected[METRIC_PSNRHVS]) {
+				result[METRIC_PSNRHVS] = phvs->getPSNRHVS();
+			}
+			if (selected[METRIC_PSNRHVSM]) {
+				result[METRIC_PSNRHVSM] = phvs->getPSNRHVSM();
+			}
+		});
+	}
+}
+
+MetricSet::~MetricSet()
+{
+	delete psnr;
+	delete ssim;
+	delete msssim;
+	delete vifp;
+	delete phvs;
+	delete ewpsnr;
+	for (int t=0; t<PYRAMID_SIZE; t++) {
+		delete original_pyramid[t];
+		delete processed_pyramid[t];
+	}
+}
+
+std::vector<int> MetricSet::addPyramidTasks(PyramidType type, int metric)
+{
+	std::vector<int> tasks;
+	// The pyramids are counted with the metric, not as calls of their own
+	tasks.push_back(graph.add([this, type, metric]() {
+		if (!isActive(metric)) return;
+		PerfScope scope(counters(metric), 0);
+		original_pyramid[type]->build(*original_frame);
+	}));
+	tasks.push_back(graph.add([this, type, metric]() {
+		if (!isActive(metric)) return;
+		PerfScope scope(counters(metric), 0);
+		processed_pyramid[type]->build(*processed_frame);
+	}));
+	return tasks;
+}
+
+PerfCounters *MetricSet::counters(int metric) const
+{
+	return perf != NULL ? perf[metric] : NULL;
+}
+
+bool MetricSet::isActive(int metric) const
+{
+	return active == NULL || active[metric];
+}
+
+void MetricSet::setBlockSize(int size)
+{
+	psnr->setBlockSize(size);
+	ssim->setBlockSize(size);
+	msssim->setBlockSize(size);
+	phvs->setBlockSize(size);
+	nblocks = size > 0 ? ((rows + size - 1) / size) * ((cols + size - 1) / size) : 0;
+}
+
+void MetricSet::compute(const cv::Mat& original, const cv::Mat& processed, int frame, float res[METRIC_SIZE], const bool *act)
+{
+	original_frame = &original;
+	processed_frame = &processed;
+	frame_no = frame;
+	result = res;
+	active = act;
+	graph.run();
+}
+
+void MetricSet::setMapsEnabled(bool enable)
+{
+	ssim->setMapEnabled(enable && selected[METRIC_SSIM]);
+	msssim->setMapEnabled(enable && selected[METRIC_SSIM]);
+	vifp->setMapEnabled(enable && selected[METRIC_VIFP]);
+}
+
+void MetricSet::setWeights(const cv::Mat& weights, const cv::Rect& bounds)
+{
+	psnr->setWeights(weights, bounds);
+	ssim->setWeights(weights, bounds);
+	msssim->setWeights(weights, bounds);
+	phvs->setWeights(weights, bounds);
+}
+
+void MetricSet::setOriginal(const char *original_file)
+{
+	if (selected[METRIC_EWPSNR]) {
+		ewpsnr->match_eye_track_data(original_file);
+	}
+}
+
+cv::Mat MetricSet::getMap(int metric) const
+{
+	if (!isComputed(metric)) {
+		return cv::Mat();
+	}
+	if (metric == METRIC_SSIM) {
+		return selected[METRIC_MSSSIM] ? msssim->getMap() : ssim->getMap();
+	}
+	return vifp->getMap();
+}
+
+bool MetricSet::isComputed(int metric) const
+{
+	// SSIM comes from MS-SSIM when both are selected
+	return isActive(metric) && (metric != METRIC_SSIM || !selected[METRIC_MSSSIM] || isActive(METRIC_MSSSIM));
+}
+
+void MetricSet::getBlockSums(double *sums) const
+{
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (!selected[m] || !METRIC_BLOCKS[m]) {
+			continue;
+		}
+		if (!isComputed(m)) {
+			std::fill(sums, sums+nblocks, std::numeric_limits<double>::quiet_NaN());
+		}
+		else if (m == METRIC_PSNR) {
+			psnr->getBlockSums(sums);
+		}
+		else if (m == METRIC_SSIM && selected[METRIC_MSSSIM]) {
+			msssim->getBlockSums(sums);
+		}
+		else if (m == METRIC_SSIM) {
+			ssim->getBlockSums(sums);
+		}
+		else if (m == METRIC_PSNRHVS) {
+			phvs->getBlockSums(NULL, sums);
+		}
+		else {
+			phvs->getBlockSums(sums, NULL);
+		}
+		sums += nblocks;
+	}
+}
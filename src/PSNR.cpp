@@ -22,7 +22,12 @@
 // maintenance, support, updates, enhancements, or modifications.
 //
 
+#include <algorithm>
+#include <limits>
+#include "AlignedMat.hpp"
+#include "Kernels.hpp"
 #include "PSNR.hpp"
+#include "Reduction.hpp"
 
 PSNR::PSNR(int h, int w) : Metric(h, w)
 {
@@ -30,8 +35,73 @@ PSNR::PSNR(int h, int w) : Metric(h, w)
 
 float PSNR::compute(const cv::Mat& original, const cv::Mat& processed)
 {
-	cv::Mat tmp(height,width,CV_32F);
-	cv::subtract(original, processed, tmp);
-	cv::multiply(tmp, tmp, tmp);
-	return float(10*log10(255*255/cv::mean(tmp).val[0]));
+	double weighted_mse;
+	if (!pixel_weights.empty()) {
+		if (!computeWeightedMSE(original, processed, weighted_mse)) return std::numeric_limits<float>::quiet_NaN();
+		return float(10*log10(255*255/weighted_mse));
+	}
+
+	// Sum of squared errors per row, reduced in a fixed order
+	const KernelTable& kernels = Kernels::get();
+	std::vector<double> sse_rows(static_cast<size_t>(height));
+	// The zero padding of aligned rows adds nothing to the sums
+	int padded = std::min(AlignedMat::paddedCols(original, width), AlignedMat::paddedCols(processed, width));
+	block_sums.assign(static_cast<size_t>(block_rows*block_cols), 0.0);
+	for (int i=0; i<height; i++) {
+		if (original.depth() == CV_8U && block_size > 0) {
+			// Sums per block, exact integers, so that their sum is the sum of the row
+			double *blocks = &block_sums[static_cast<size_t>((i/block_size)*block_cols)];
+			double sse = 0.0;
+			for (int b=0; b<block_cols; b++) {
+				int x = b*block_size;
+				int n = std::min(block_size, (b == block_cols-1 ? padded : width) - x);
+				double block = kernels.sumSquaredDiff8u(original.ptr<uchar>(i)+x, processed.ptr<uchar>(i)+x, n);
+				blocks[b] += block;
+				sse += block;
+			}
+			sse_rows[static_cast<size_t>(i)] = sse;
+		}
+		else if (original.depth() == CV_8U) {
+			sse_rows[static_cast<size_t>(i)] = kernels.sumSquaredDiff8u(original.ptr<uchar>(i), processed.ptr<uchar>(i), padded);
+		}
+		else {
+			sse_rows[static_cast<size_t>(i)] = kernels.sumSquaredDiff(original.ptr<float>(i), processed.ptr<float>(i), width);
+			double *blocks = block_size > 0 ? &block_sums[static_cast<size_t>((i/block_size)*block_cols)] : NULL;
+			for (int b=0; b<block_cols; b++) {
+				int x = b*block_size;
+				blocks[b] += kernels.sumSquaredDiff(original.ptr<float>(i)+x, processed.ptr<float>(i)+x, std::min(block_size, width - x));
+			}
+		}
+	}
+	double mse = Reduction::pairwise(sse_rows) / (static_cast<double>(height)*width);
+	return float(10*log10(255*255/mse));
+}
+
+bool PSNR::computeWeightedMSE(const cv::Mat& original, const cv::Mat& processed, double& mse) const
+{
+	// The pixels out of the bounds are skipped, their weights are zero
+	cv::Rect roi = weight_bounds & cv::Rect(0, 0, width, height);
+	if (roi.area() <= 0) return false;
+	const KernelTable& kernels = Kernels::get();
+	std::vector<double> sse_rows(static_cast<size_t>(roi.height)), weight_rows(static_cast<size_t>(roi.height));
+	for (int i=0; i<roi.height; i++) {
+		int y = roi.y + i;
+		const float *weights = pixel_weights.ptr<float>(y) + roi.x;
+		if (original.depth() == CV_8U) {
+			sse_rows[static_cast<size_t>(i)] = kernels.sumSquaredDiffWeighted8u(original.ptr<uchar>(y) + roi.x, processed.ptr<uchar>(y) + roi.x, weights, roi.width);
+		}
+		else {
+			sse_rows[static_cast<size_t>(i)] = kernels.sumSquaredDiffWeighted(original.ptr<float>(y) + roi.x, processed.ptr<float>(y) + roi.x, weights, roi.width);
+		}
+		weight_rows[static_cast<size_t>(i)] = kernels.sumRow(weights, roi.width);
+	}
+	double total = Reduction::pairwise(weight_rows);
+	if (!(total > 0.0)) return false;
+	mse = Reduction::pairwise(sse_rows) / total;
+	return true;
+}
+
+void PSNR::getBlockSums(double *sums) const
+{
+	std::copy(block_sums.begin(), block_sums.end(), sums);
 }
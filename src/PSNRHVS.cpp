@@ -39,8 +39,13 @@
 //   Processing and Quality Metrics for Consumer Electronics, January 2007.
 //
 
+#include <algorithm>
 #include <cfloat>
+#include <limits>
+#include "Kernels.hpp"
 #include "PSNRHVS.hpp"
+#include "Reduction.hpp"
+#include "ThreadPool.hpp"
 
 const float PSNRHVS::CSF[8][8]  =	{{1.608443f, 2.339554f, 2.573509f, 1.608443f, 1.072295f, 0.643377f, 0.504610f, 0.421887f},
 									 {2.144591f, 2.144591f, 1.838221f, 1.354478f, 0.989811f, 0.443708f, 0.428918f, 0.467911f},
@@ -76,22 +81,132 @@ float PSNRHVS::getPSNRHVSM()
 
 float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
 {
-	float s1 = 0.0f;
-	float s2 = 0.0f;
-	float num = static_cast<float>(width*height);
+	if (!pixel_weights.empty()) {
+		computeWeighted(original, processed);
+		return psnrhvsm;
+	}
+
+	double num = static_cast<double>(width)*height;
+	int nrows = (height+7)/8;
+
+	// Partial sums per row of blocks, reduced in a fixed order
+	std::vector<double> s1_rows(static_cast<size_t>(nrows), 0.0);
+	std::vector<double> s2_rows(static_cast<size_t>(nrows), 0.0);
+	if (block_size > 0) {
+		block_row_sums.assign(static_cast<size_t>(nrows*2*block_cols), 0.0);
+	}
+
+	// Rows of blocks are independent
+	ThreadPool::instance().parallelFor(nrows, 1, [&](int begin, int end) {
+		computeBlockRows(original, processed, begin, end, 0, width, s1_rows.data(), s2_rows.data(), block_size > 0 ? block_row_sums.data() : NULL, NULL);
+	});
+
+	if (block_size > 0) {
+		block_s1.assign(static_cast<size_t>(block_rows*block_cols), 0.0);
+		block_s2.assign(static_cast<size_t>(block_rows*block_cols), 0.0);
+		for (int r=0; r<nrows; r++) {
+			size_t dst = static_cast<size_t>((8*r/block_size)*block_cols);
+			const double *src = &block_row_sums[static_cast<size_t>(r*2*block_cols)];
+			for (int b=0; b<block_cols; b++) {
+				block_s1[dst+static_cast<size_t>(b)] += src[2*b];
+				block_s2[dst+static_cast<size_t>(b)] += src[2*b+1];
+			}
+		}
+	}
+
+	// s1 = s1/num;
+	double s1 = Reduction::pairwise(s1_rows) / num;
+	// s2 = s2/num;
+	double s2 = Reduction::pairwise(s2_rows) / num;
+	setIndexes(s1, s2);
+
+	return psnrhvsm;
+}
+
+void PSNRHVS::computeWeighted(const cv::Mat& original, const cv::Mat& processed)
+{
+	// Only the 8x8 blocks that overlap the bounds have weights
+	cv::Rect roi = weight_bounds & cv::Rect(0, 0, width, height);
+	if (roi.area() <= 0) {
+		psnrhvs = psnrhvsm = std::numeric_limits<float>::quiet_NaN();
+		return;
+	}
+	int first = roi.y/8;
+	int last = (roi.y+roi.height+7)/8;
+	int x_begin = roi.x/8*8;
+	int x_end = std::min((roi.x+roi.width+7)/8*8, width);
+
+	// Partial sums per row of blocks, those out of the bounds staying zero
+	size_t nrows = static_cast<size_t>((height+7)/8);
+	std::vector<double> s1_rows(nrows, 0.0), s2_rows(nrows, 0.0), weight_rows(nrows, 0.0);
+	ThreadPool::instance().parallelFor(last-first, 1, [&](int begin, int end) {
+		computeBlockRows(original, processed, first+begin, first+end, x_begin, x_end, s1_rows.data(), s2_rows.data(), NULL, weight_rows.data());
+	});
+
+	double total = Reduction::pairwise(weight_rows);
+	if (!(total > 0.0)) {
+		psnrhvs = psnrhvsm = std::numeric_limits<float>::quiet_NaN();
+		return;
+	}
+	setIndexes(Reduction::pairwise(s1_rows) / total, Reduction::pairwise(s2_rows) / total);
+}
+
+void PSNRHVS::setIndexes(double s1, double s2)
+{
+	// if s1 == 0: p_hvs_m = 100000;
+	// else: p_hvs_m = 10*log10(255*255/s1);
+	psnrhvsm = s1 <= static_cast<double>(FLT_EPSILON) ? 100000.0f : float(10*log10(255*255/s1));
+	// if s2 == 0: p_hvs = 100000;
+	// else: p_hvs = 10*log10(255*255/s2);
+	psnrhvs = s2 <= static_cast<double>(FLT_EPSILON) ? 100000.0f : float(10*log10(255*255/s2));
+}
+
+void PSNRHVS::getBlockSums(double *hvsm, double *hvs) const
+{
+	if (hvsm) {
+		std::copy(block_s1.begin(), block_s1.end(), hvsm);
+	}
+	if (hvs) {
+		std::copy(block_s2.begin(), block_s2.end(), hvs);
+	}
+}
+
+void PSNRHVS::computeBlockRows(const cv::Mat& original, const cv::Mat& processed, int begin, int end, int x_begin, int x_end, double *s1_rows, double *s2_rows, double *row_blocks, double *weight_rows)
+{
 	float tmp;
 	cv::Mat a(8,8,CV_32F), b(8,8,CV_32F), a_dct(8,8,CV_32F), b_dct(8,8,CV_32F);
+	// One row of blocks of each image, widened to float
+	cv::Mat strip1(8,width,CV_32F), strip2(8,width,CV_32F);
+	const KernelTable& kernels = Kernels::get();
+
+	for (int y=8*begin; y<8*end; y+=8) {
+		double &s1 = s1_rows[y/8];
+		double &s2 = s2_rows[y/8];
+		cv::Mat dst1 = strip1.colRange(x_begin,x_end), dst2 = strip2.colRange(x_begin,x_end);
+		original(cv::Range(y,y+8), cv::Range(x_begin,x_end)).convertTo(dst1, CV_32F);
+		processed(cv::Range(y,y+8), cv::Range(x_begin,x_end)).convertTo(dst2, CV_32F);
+		for (int x=x_begin; x<x_end; x+=8) {
+			// Weight of the block: the sum of the weights of its pixels
+			double weight = 0.0;
+			if (weight_rows) {
+				for (int k=0; k<8; k++) {
+					weight += kernels.sumRow(pixel_weights.ptr<float>(y+k)+x, 8);
+				}
+				if (!(weight > 0.0)) continue;
+				weight_rows[y/8] += weight;
+			}
+			// Errors weighted by the mean weight of the block, one by one in
+			// the order of the unweighted sums (scaling by 1 is exact)
+			double scale = weight_rows ? weight/64 : 1.0;
 
-	for (int y=0; y<height; y+=8) {
-		for (int x=0; x<width; x+=8) {
 			// a = img1(y:y+7,x:x+7);
-			a = original(cv::Range(y,y+8),cv::Range(x,x+8));
+			a = strip1.colRange(x,x+8);
 			// b = img2(y:y+7,x:x+7);
-			b = processed(cv::Range(y,y+8),cv::Range(x,x+8));
+			b = strip2.colRange(x,x+8);
 			// a_dct = dct2(a);
-			cv::dct(a, a_dct);
+			kernels.dct8x8(a.ptr<float>(0), a.step1(), a_dct.ptr<float>(0));
 			// b_dct = dct2(b);
-			cv::dct(b, b_dct);
+			kernels.dct8x8(b.ptr<float>(0), b.step1(), b_dct.ptr<float>(0));
 
 			// mask_a = maskeff(a,a_dct);
 			float mask_a = maskeff(a,a_dct);
@@ -101,6 +216,8 @@ float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
 			// if mask_b > mask_a: mask_a = mask_b;
 			mask_a = mask_b > mask_a ? mask_b : mask_a;
 
+			// Errors of this 8x8 block alone, for the sums over larger blocks
+			double b1 = 0.0, b2 = 0.0;
 			for (int k=0; k<8; k++) {
 				const float *ptr_a = a_dct.ptr<float>(k);
 				const float *ptr_b = b_dct.ptr<float>(k);
@@ -109,7 +226,8 @@ float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
 					float u = std::abs(*ptr_a++ - *ptr_b++);
 					// s2 = s2 + (u*CSF(k,l)).^2;
 					tmp = u*CSF[k][l];
-					s2 += tmp*tmp;
+					s2 += scale*static_cast<double>(tmp*tmp);
+					b2 += static_cast<double>(tmp*tmp);
 					// if (k~=1) | (l~=1)
 					if (k != 0 || l !=0) {
 						// if u < mask_a/mask(k,l)
@@ -125,25 +243,17 @@ float PSNRHVS::compute(const cv::Mat& original, const cv::Mat& processed)
 					}
 					// s1 = s1 + (u*CSF(k,l)).^2;
 					tmp = u*CSF[k][l];
-					s1 += tmp*tmp;
+					s1 += scale*static_cast<double>(tmp*tmp);
+					b1 += static_cast<double>(tmp*tmp);
 				}
 			}
+			if (row_blocks) {
+				double *sums = &row_blocks[(y/8)*2*block_cols + 2*(x/block_size)];
+				sums[0] += b1;
+				sums[1] += b2;
+			}
 		}
 	}
-
-	// s1 = s1/num;
-	s1 /= num;
-	// s2 = s2/num;
-	s2 /= num;
-
-	// if s1 == 0: p_hvs_m = 100000;
-	// else: p_hvs_m = 10*log10(255*255/s1);
-	psnrhvsm = s1 <= FLT_EPSILON ? 100000.0f : float(10*log10(255*255/s1));
-	// if s2 == 0: p_hvs = 100000;
-	// else: p_hvs = 10*log10(255*255/s2);
-	psnrhvs = s2 <= FLT_EPSILON ? 100000.0f : float(10*log10(255*255/s2));
-
-	return psnrhvsm;
 }
 
 float PSNRHVS::maskeff(const cv::Mat &z, const cv::Mat &zdct)
@@ -0,0 +1,211 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <string.h>
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif /* __linux__ */
+
+static const char *EVENT_NAME[PERF_EVENT_SIZE] = {"cycles", "instructions", "LLC-misses", "branch-misses", "dTLB-load-misses"};
+
+#ifdef __linux__
+
+static const uint32_t EVENT_TYPE[PERF_EVENT_SIZE] = {
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE,
+	PERF_TYPE_HW_CACHE
+};
+
+static const uint64_t EVENT_CONFIG[PERF_EVENT_SIZE] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+};
+
+// Counters of one thread, opened on first use and closed on thread exit
+class ThreadCounters {
+public:
+	ThreadCounters()
+	{
+		for (int e=0; e<PERF_EVENT_SIZE; e++) {
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = EVENT_TYPE[e];
+			attr.config = EVENT_CONFIG[e];
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			// pid = 0, cpu = -1: calling thread on any CPU
+			fd[e] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+		}
+	}
+	~ThreadCounters()
+	{
+		for (int e=0; e<PERF_EVENT_SIZE; e++) {
+			if (fd[e] >= 0) close(fd[e]);
+		}
+	}
+	// Read one counter, scaled for the time it was multiplexed out
+	bool read(int e, uint64_t& value) const
+	{
+		uint64_t buf[3];
+		if (fd[e] < 0 || ::read(fd[e], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) {
+			return false;
+		}
+		value = buf[0];
+		if (buf[2] > 0 && buf[2] < buf[1]) {
+			value = static_cast<uint64_t>(static_cast<double>(buf[0])*static_cast<double>(buf[1])/static_cast<double>(buf[2]));
+		}
+		return true;
+	}
+	bool opened() const
+	{
+		for (int e=0; e<PERF_EVENT_SIZE; e++) {
+			if (fd[e] >= 0) return true;
+		}
+		return false;
+	}
+private:
+	int fd[PERF_EVENT_SIZE];
+};
+
+static ThreadCounters& threadCounters()
+{
+	static thread_local ThreadCounters counters;
+	return counters;
+}
+
+#endif /* __linux__ */
+
+PerfCounters::PerfCounters(const char *n)
+{
+	name = n;
+	calls = 0;
+	pixels = 0;
+	for (int e=0; e<PERF_EVENT_SIZE; e++) {
+		total[e] = 0;
+		valid[e] = true;
+	}
+}
+
+bool PerfCounters::available()
+{
+#ifdef __linux__
+	return threadCounters().opened();
+#else
+	return false;
+#endif /* __linux__ */
+}
+
+PerfCounters::Sample PerfCounters::read()
+{
+	Sample s;
+	for (int e=0; e<PERF_EVENT_SIZE; e++) {
+		s.value[e] = 0;
+#ifdef __linux__
+		s.valid[e] = threadCounters().read(e, s.value[e]);
+#else
+		s.valid[e] = false;
+#endif /* __linux__ */
+	}
+	return s;
+}
+
+void PerfCounters::accumulate(const Sample& begin, long long npixels)
+{
+	Sample end = read();
+
+	std::lock_guard<std::mutex> guard(lock);
+	for (int e=0; e<PERF_EVENT_SIZE; e++) {
+		if (begin.valid[e] && end.valid[e] && end.value[e] >= begin.value[e]) {
+			total[e] += end.value[e] - begin.value[e];
+		}
+		else {
+			valid[e] = false;
+		}
+	}
+	if (npixels > 0) {
+		calls++;
+		pixels += npixels;
+	}
+}
+
+void PerfCounters::report(FILE *out) const
+{
+	if (calls == 0) return;
+
+	double px = static_cast<double>(pixels);
+	fprintf(out, "%s: %lld calls", name, calls);
+	for (int e=0; e<PERF_EVENT_SIZE; e++) {
+		if (valid[e]) {
+			fprintf(out, ", %s/px %.3f", EVENT_NAME[e], static_cast<double>(total[e])/px);
+		}
+		else {
+			fprintf(out, ", %s n/a", EVENT_NAME[e]);
+		}
+	}
+	if (valid[PERF_CYCLES] && valid[PERF_INSTRUCTIONS] && total[PERF_CYCLES] > 0) {
+		fprintf(out, ", IPC %.3f", static_cast<double>(total[PERF_INSTRUCTIONS])/static_cast<double>(total[PERF_CYCLES]));
+	}
+	fprintf(out, "\n");
+}
+
+// Innermost scope with counters of the calling thread
+static thread_local PerfScope *innermost = NULL;
+
+PerfScope::PerfScope(PerfCounters *c, long long n)
+{
+	counters = c;
+	npixels = n;
+	parent = NULL;
+	if (counters == NULL) return;
+	// The enclosing scope stops counting until this one ends
+	parent = innermost;
+	if (parent != NULL) parent->counters->accumulate(parent->begin, 0);
+	innermost = this;
+	begin = PerfCounters::read();
+}
+
+PerfScope::~PerfScope()
+{
+	if (counters == NULL) return;
+	counters->accumulate(begin, npixels);
+	innermost = parent;
+	if (parent != NULL) parent->begin = PerfCounters::read();
+}
+
+PerfCounters *PerfScope::current()
+{
+	return innermost != NULL ? innermost->counters : NULL;
+}
@@ -0,0 +1,290 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <chrono>
+#include <thread>
+#include "Pipeline.hpp"
+
+static const char *STAGE_NAME[STAGE_SIZE] = {"read", "compute", "write"};
+static const int DEFAULT_DEPTH = 4;
+
+static long long nowNs()
+{
+	return static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Pipeline::Pipeline(VideoYUV *original, VideoYUV *processed, int nbf)
+{
+	video[0] = original;
+	video[1] = processed;
+	first_frame = 0;
+	nbframes = nbf;
+	sampler = NULL;
+	scheduler = NULL;
+	block_writer = NULL;
+	map_writer = NULL;
+	weight_mask = NULL;
+	aligner = NULL;
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		depth[s] = DEFAULT_DEPTH;
+		queue[s] = NULL;
+	}
+	for (int s=0; s<STAGE_SIZE; s++) {
+		threads[s] = 1;
+		running[s] = 0;
+		busy_ns[s] = 0;
+	}
+	free_slots = NULL;
+	read_failed = false;
+	stopped = false;
+	wall_time = 0.0;
+	unpack_time = 0.0;
+	latency_sum = 0.0;
+	latency_max = 0.0;
+	frames_done = 0;
+}
+
+Pipeline::~Pipeline()
+{
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		delete queue[s];
+	}
+	delete free_slots;
+	for (size_t i=0; i<slots.size(); i++) {
+		delete slots[i];
+	}
+}
+
+void Pipeline::setDepth(int stage, int d)
+{
+	depth[stage] = d > 0 ? d : 1;
+}
+
+void Pipeline::setFirstFrame(int frame)
+{
+	first_frame = frame;
+}
+
+void Pipeline::setSampler(FrameSampler *s)
+{
+	sampler = s;
+}
+
+void Pipeline::setScheduler(LiveScheduler *s)
+{
+	scheduler = s;
+}
+
+void Pipeline::setBlockWriter(BlockWriter *w)
+{
+	block_writer = w;
+}
+
+void Pipeline::setMapWriter(MapWriter *w)
+{
+	map_writer = w;
+}
+
+void Pipeline::setWeightMask(WeightMask *m)
+{
+	weight_mask = m;
+}
+
+void Pipeline::setAligner(const FrameAligner *a)
+{
+	aligner = a;
+}
+
+bool Pipeline::run(const std::vector<MetricSet*>& metrics, ResultWriter *writer)
+{
+	long long start = nowNs();
+	threads[STAGE_COMPUTE] = static_cast<int>(metrics.size());
+
+	// Enough frame buffers to fill all queues and keep every thread busy
+	int nslots = 1;
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		queue[s] = new SlotQueue(static_cast<size_t>(depth[s]));
+		nslots += depth[s];
+	}
+	for (int s=0; s<STAGE_SIZE; s++) {
+		nslots += threads[s];
+		running[s] = threads[s];
+	}
+	free_slots = new SlotQueue(static_cast<size_t>(nslots));
+	for (int i=0; i<nslots; i++) {
+		slots.push_back(new FrameSlot());
+		if (block_writer != NULL) slots.back()->blocks.resize(static_cast<size_t>(block_writer->getFrameSums()));
+		free_slots->push(slots.back());
+	}
+	for (size_t t=0; t<metrics.size(); t++) {
+		metrics[t]->setBlockSize(block_writer != NULL ? block_writer->getBaseSize() : 0);
+		metrics[t]->setMapsEnabled(map_writer != NULL);
+	}
+
+	double unpacked = video[0]->getUnpackTime() + video[1]->getUnpackTime();
+	if (scheduler != NULL) scheduler->start();
+	std::vector<std::thread> workers;
+	workers.push_back(std::thread(&Pipeline::readStage, this));
+	for (size_t t=0; t<metrics.size(); t++) {
+		workers.push_back(std::thread(&Pipeline::computeStage, this, metrics[t]));
+	}
+	writeStage(writer);
+	for (size_t t=0; t<workers.size(); t++) {
+		workers[t].join();
+	}
+
+	wall_time = static_cast<double>(nowNs() - start)*1e-9;
+	unpack_time = video[0]->getUnpackTime() + video[1]->getUnpackTime() - unpacked;
+	return !read_failed;
+}
+
+void Pipeline::readStage()
+{
+	FrameSlot *slot;
+	int next = first_frame;
+	for (int index=0; !stopped; index++) {
+		int frame = sampler != NULL ? sampler->next() : next++;
+		// Processed frames without an original frame are not compared
+		while (aligner != NULL && frame < nbframes && aligner->getOriginal(frame) < 0) frame = next++;
+		if (frame < 0 || frame >= nbframes) break;
+		if (!free_slots->pop(slot)) break;
+		if (scheduler != NULL) {
+			scheduler->waitDue(index);
+			scheduler->plan(index, slot->active);
+		}
+		long long start = nowNs();
+		slot->frame = frame;
+		slot->index = index;
+		bool ok = true;
+		for (int v=0; v<2 && ok; v++) {
+			int f = v == 0 && aligner != NULL ? aligner->getOriginal(frame) : frame;
+			ok = ((sampler == NULL && aligner == NULL) || video[v]->seekFrame(f)) && video[v]->readOneFrame();
+			if (ok) video[v]->getLuma(slot->luma[v], CV_8UC1);
+		}
+		if (ok && weight_mask != NULL) ok = weight_mask->read(frame, slot->weights, slot->bounds);
+		busy_ns[STAGE_READ] += nowNs() - start;
+		if (!ok) {
+			read_failed = true;
+			break;
+		}
+		queue[STAGE_READ]->push(slot);
+	}
+	queue[STAGE_READ]->close();
+	running[STAGE_READ]--;
+}
+
+void Pipeline::computeStage(MetricSet *metrics)
+{
+	FrameSlot *slot;
+	while (queue[STAGE_READ]->pop(slot)) {
+		long long start = nowNs();
+		metrics->setWeights(slot->weights, slot->bounds);
+		metrics->compute(slot->luma[0], slot->luma[1], slot->frame, slot->result, scheduler != NULL ? slot->active : NULL);
+		if (block_writer != NULL) metrics->getBlockSums(slot->blocks.data());
+		if (map_writer != NULL) map_writer->add(slot->frame, *metrics);
+		long long elapsed = nowNs() - start;
+		slot->latency = static_cast<double>(elapsed)*1e-9;
+		busy_ns[STAGE_COMPUTE] += elapsed;
+		queue[STAGE_COMPUTE]->push(slot);
+	}
+	// The last thread of the stage closes the next queue
+	if (--running[STAGE_COMPUTE] == 0) queue[STAGE_COMPUTE]->close();
+}
+
+void Pipeline::writeStage(ResultWriter *writer)
+{
+	// Frames completed out of order, indexed by position modulo the number of slots
+	std::vector<FrameSlot*> pending(slots.size(), NULL);
+	int next = 0;
+	FrameSlot *slot;
+	while (queue[STAGE_COMPUTE]->pop(slot)) {
+		pending[static_cast<size_t>(slot->index) % pending.size()] = slot;
+		for (;;) {
+			FrameSlot *&ready = pending[static_cast<size_t>(next) % pending.size()];
+			if (ready == NULL || ready->index != next) break;
+
+			// Frames read after the sampler stopped are dropped
+			if (!stopped) {
+				long long start = nowNs();
+				writer->write(ready->frame, ready->result, scheduler != NULL ? ready->active : NULL);
+				if (block_writer != NULL) block_writer->write(ready->frame, ready->blocks.data());
+				latency_sum += ready->latency;
+				if (ready->latency > latency_max) latency_max = ready->latency;
+				frames_done++;
+				if (sampler != NULL && sampler->add(ready->result)) stopped = true;
+				if (scheduler != NULL) scheduler->done(ready->index, ready->frame, ready->active);
+				busy_ns[STAGE_WRITE] += nowNs() - start;
+			}
+
+			free_slots->push(ready);
+			ready = NULL;
+			next++;
+		}
+	}
+	free_slots->close();
+	running[STAGE_WRITE]--;
+}
+
+double Pipeline::getMeanLatency() const
+{
+	return frames_done > 0 ? latency_sum/frames_done : 0.0;
+}
+
+int Pipeline::getFrames() const
+{
+	return frames_done;
+}
+
+double Pipeline::getMaxLatency() const
+{
+	return latency_max;
+}
+
+void Pipeline::report(FILE *out) const
+{
+	if (wall_time <= 0.0) return;
+
+	int bottleneck = 0;
+	double max_util = -1.0;
+	fprintf(out, "Pipeline (%.3fs):\n", wall_time);
+	for (int s=0; s<STAGE_SIZE; s++) {
+		// Fraction of the time the threads of the stage were processing frames
+		double util = static_cast<double>(busy_ns[s].load())*1e-9 / (wall_time*threads[s]);
+		if (util > max_util) {
+			max_util = util;
+			bottleneck = s;
+		}
+		fprintf(out, "  %-8s %2d thread(s), busy %5.1f%%", STAGE_NAME[s], threads[s], 100*util);
+		if (s == STAGE_READ && unpack_time > 0.0) {
+			// CPU work of the read stage, apart from the I/O
+			fprintf(out, " (unpacking %.1f%%)", 100*unpack_time/wall_time);
+		}
+		if (s < STAGE_SIZE-1 && queue[s] != NULL) {
+			fprintf(out, ", output queue %d: mean occupancy %.2f, producers blocked %.3fs, consumers blocked %.3fs",
+					depth[s], queue[s]->meanOccupancy(), queue[s]->fullTime(), queue[s]->emptyTime());
+		}
+		fprintf(out, "\n");
+	}
+	fprintf(out, "  bottleneck: %s\n", STAGE_NAME[bottleneck]);
+}
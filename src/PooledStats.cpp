@@ -0,0 +1,218 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <sstream>
+#include "PooledStats.hpp"
+
+const int PooledStats::DEFAULT_CAPACITY;
+
+PooledStats::PooledStats(int c)
+{
+	capacity = c > 8 ? c : 8;
+	n = 0;
+	min_value = 0.0;
+	max_value = 0.0;
+	not_positive = 0;
+	levels.resize(1);
+	compactions.resize(1);
+}
+
+void PooledStats::add(double x)
+{
+	min_value = n == 0 || x < min_value ? x : min_value;
+	max_value = n == 0 || x > max_value ? x : max_value;
+	n++;
+	sum.add(x);
+	if (x > 0.0) {
+		inverse_sum.add(1.0/x);
+	}
+	else {
+		not_positive++;
+	}
+	levels[0].push_back(x);
+	compact();
+}
+
+void PooledStats::merge(const PooledStats& other)
+{
+	if (other.n == 0) return;
+	min_value = n == 0 || other.min_value < min_value ? other.min_value : min_value;
+	max_value = n == 0 || other.max_value > max_value ? other.max_value : max_value;
+	n += other.n;
+	sum.add(other.sum.getSum());
+	sum.add(other.sum.getCompensation());
+	inverse_sum.add(other.inverse_sum.getSum());
+	inverse_sum.add(other.inverse_sum.getCompensation());
+	not_positive += other.not_positive;
+	if (levels.size() < other.levels.size()) {
+		levels.resize(other.levels.size());
+		compactions.resize(other.levels.size());
+	}
+	for (size_t h=0; h<other.levels.size(); h++) {
+		levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+	}
+	compact();
+}
+
+void PooledStats::compact()
+{
+	for (size_t h=0; h<levels.size(); h++) {
+		// Capacity of the level: that of the sketch for the top level, 2/3
+		// of the capacity of the level above for the others, at least 8
+		double level_capacity = capacity;
+		for (size_t above=h+1; above<levels.size(); above++) {
+			level_capacity *= 2.0/3.0;
+		}
+		if (static_cast<double>(levels[h].size()) <= std::max(level_capacity, 8.0)) continue;
+
+		if (h+1 == levels.size()) {
+			levels.resize(h+2);
+			compactions.resize(h+2);
+		}
+		std::vector<double>& level = levels[h];
+		std::sort(level.begin(), level.end());
+		// Promote one score of each pair, the last one stays if the number is odd
+		size_t offset = compactions[h]++ % 2;
+		size_t pairs = level.size()/2;
+		for (size_t i=0; i<pairs; i++) {
+			levels[h+1].push_back(level[2*i+offset]);
+		}
+		level.erase(level.begin(), level.begin()+static_cast<long>(2*pairs));
+	}
+}
+
+long long PooledStats::count() const
+{
+	return n;
+}
+
+double PooledStats::min() const
+{
+	return min_value;
+}
+
+double PooledStats::max() const
+{
+	return max_value;
+}
+
+double PooledStats::mean() const
+{
+	return n > 0 ? sum.value()/static_cast<double>(n) : 0.0;
+}
+
+double PooledStats::harmonicMean() const
+{
+	return n > 0 && not_positive == 0 ? static_cast<double>(n)/inverse_sum.value() : 0.0;
+}
+
+double PooledStats::quantile(double q) const
+{
+	if (n == 0) return 0.0;
+
+	// Scores with their weights, by increasing score
+	std::vector<std::pair<double, long long> > items;
+	for (size_t h=0; h<levels.size(); h++) {
+		for (size_t i=0; i<levels[h].size(); i++) {
+			items.push_back(std::make_pair(levels[h][i], 1LL << h));
+		}
+	}
+	std::sort(items.begin(), items.end());
+
+	// Scores of ranks floor(p) and floor(p)+1, each item covering as many
+	// ranks as its weight
+	q = std::min(std::max(q, 0.0), 1.0);
+	double p = q*static_cast<double>(n-1);
+	long long rank = static_cast<long long>(p);
+	double value[2] = {items.back().first, items.back().first};
+	long long end = 0;
+	for (size_t i=0, r=0; i<items.size() && r<2; i++) {
+		end += items[i].second;
+		while (r < 2 && rank+static_cast<long long>(r) < end) {
+			value[r++] = items[i].first;
+		}
+	}
+	double result = value[0] + (p-static_cast<double>(rank))*(value[1]-value[0]);
+	return std::min(std::max(result, min_value), max_value);
+}
+
+std::string PooledStats::save() const
+{
+	// Doubles in hexadecimal, to be exact
+	std::ostringstream out;
+	char buf[64];
+	double values[6] = {min_value, max_value, sum.getSum(), sum.getCompensation(), inverse_sum.getSum(), inverse_sum.getCompensation()};
+	out << capacity << ' ' << n << ' ' << not_positive;
+	for (int i=0; i<6; i++) {
+		snprintf(buf, sizeof(buf), " %a", values[i]);
+		out << buf;
+	}
+	out << ' ' << levels.size();
+	for (size_t h=0; h<levels.size(); h++) {
+		out << ' ' << compactions[h] << ' ' << levels[h].size();
+		for (size_t i=0; i<levels[h].size(); i++) {
+			snprintf(buf, sizeof(buf), " %a", levels[h][i]);
+			out << buf;
+		}
+	}
+	return out.str();
+}
+
+bool PooledStats::load(const std::string& text)
+{
+	std::istringstream in(text);
+	std::string token[6];
+	size_t nlevels = 0;
+	in >> capacity >> n >> not_positive;
+	for (int i=0; i<6; i++) {
+		in >> token[i];
+	}
+	in >> nlevels;
+	if (!in || capacity < 8 || n < 0 || nlevels < 1 || nlevels > 64) return false;
+
+	double values[6];
+	for (int i=0; i<6; i++) {
+		values[i] = strtod(token[i].c_str(), NULL);
+	}
+	min_value = values[0];
+	max_value = values[1];
+	sum = CompensatedSum(values[2], values[3]);
+	inverse_sum = CompensatedSum(values[4], values[5]);
+
+	levels.assign(nlevels, std::vector<double>());
+	compactions.assign(nlevels, 0);
+	for (size_t h=0; h<nlevels; h++) {
+		size_t size = 0;
+		in >> compactions[h] >> size;
+		for (size_t i=0; i<size && in; i++) {
+			std::string value;
+			in >> value;
+			levels[h].push_back(strtod(value.c_str(), NULL));
+		}
+	}
+	return !in.fail();
+}
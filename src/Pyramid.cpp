@@ -0,0 +1,120 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include "Pyramid.hpp"
+#include "AlignedMat.hpp"
+#include "GaussianFilter.hpp"
+#include "Kernels.hpp"
+#include "Metric.hpp"
+#include "ThreadPool.hpp"
+
+// N=2^(4-scale+1)+1;
+const int Pyramid::VIFP_WINDOW[] = {17, 9, 5, 3};
+
+Pyramid::Pyramid(PyramidType t)
+{
+	type = t;
+	levels.resize(static_cast<size_t>(type == PYRAMID_MSSSIM ? MSSSIM_LEVELS : VIFP_LEVELS));
+}
+
+void Pyramid::build(const cv::Mat& image)
+{
+	levels[0] = image;
+
+	for (int l=1; l<getLevels(); l++) {
+		int w = getLevelSize(image.cols, l);
+		int h = getLevelSize(image.rows, l);
+		// No reallocation once the first frame has been built
+		AlignedMat::create(levels[static_cast<size_t>(l)], h, w, CV_32F);
+
+		ThreadPool::instance().parallelFor(h, Metric::bandHeight(h), [this, l](int begin, int end) {
+			downsample(l, begin, end);
+		});
+	}
+}
+
+int Pyramid::getLevels() const
+{
+	return static_cast<int>(levels.size());
+}
+
+const cv::Mat& Pyramid::getLevel(int l) const
+{
+	return levels[static_cast<size_t>(l)];
+}
+
+int Pyramid::getLevelSize(int size, int l) const
+{
+	for (int i=1; i<=l; i++) {
+		if (type == PYRAMID_MSSSIM) {
+			// filtered_im = imfilter(im, downsample_filter, 'symmetric', 'same');
+			// im = filtered_im(1:2:end, 1:2:end);
+			size = (size+1) / 2;
+		}
+		else {
+			// ref=filter2(win,ref,'valid'); ref=ref(1:2:end,1:2:end);
+			size = (size-(VIFP_WINDOW[i]-1)+1) / 2;
+		}
+	}
+	return size;
+}
+
+int Pyramid::getMinSize() const
+{
+	int size = 1;
+	for (int l=0; l<getLevels(); l++) {
+		// Window of SSIM (11x11) or VIFp at level l
+		int window = type == PYRAMID_MSSSIM ? 11 : VIFP_WINDOW[l];
+		while (getLevelSize(size, l) < window) {
+			size++;
+		}
+	}
+	return size;
+}
+
+void Pyramid::downsample(int l, int begin, int end)
+{
+	const cv::Mat& src = levels[static_cast<size_t>(l-1)];
+	cv::Mat dst = levels[static_cast<size_t>(l)].rowRange(begin, end);
+
+	if (type == PYRAMID_MSSSIM) {
+		const KernelTable& kernels = Kernels::get();
+		for (int y=0; y<dst.rows; y++) {
+			int row0 = 2*(begin+y);
+			// Symmetric padding: an odd last row is averaged with itself
+			int row1 = row0+1 < src.rows ? row0+1 : row0;
+			if (src.depth() == CV_8U) {
+				kernels.downsample2x2_8u(src.ptr<uchar>(row0), src.ptr<uchar>(row1), dst.ptr<float>(y), src.cols);
+			}
+			else {
+				kernels.downsample2x2(src.ptr<float>(row0), src.ptr<float>(row1), dst.ptr<float>(y), src.cols);
+			}
+		}
+	}
+	else {
+		// Output rows [begin, end) only depend on input rows [2*begin, 2*(end-1)+N)
+		int N = VIFP_WINDOW[l];
+		GaussianFilter::get(N, N/5.0).applyDecimated(src.rowRange(2*begin, 2*(end-1)+N), dst);
+	}
+}
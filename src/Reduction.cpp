@@ -0,0 +1,69 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <cmath>
+#include "Kernels.hpp"
+#include "Reduction.hpp"
+
+// Below this number of elements, partials are added sequentially
+static const int PAIRWISE_BLOCK = 8;
+
+double Reduction::sumRow(const float *row, int n)
+{
+	// Four interleaved accumulators (element j goes to j%4, the tail to the
+	// first one), combined as (s0 + s1) + (s2 + s3), see Kernels.inl
+	return Kernels::get().sumRow(row, n);
+}
+
+double Reduction::pairwise(const double *partial, int n)
+{
+	if (n <= PAIRWISE_BLOCK) {
+		double s = 0.0;
+		for (int i=0; i<n; i++) {
+			s += partial[i];
+		}
+		return s;
+	}
+	int half = n / 2;
+	return pairwise(partial, half) + pairwise(partial + half, n - half);
+}
+
+double Reduction::pairwise(const std::vector<double>& partial)
+{
+	return pairwise(partial.data(), static_cast<int>(partial.size()));
+}
+
+double Reduction::sum(const cv::Mat& m)
+{
+	std::vector<double> partial(static_cast<size_t>(m.rows));
+	for (int i=0; i<m.rows; i++) {
+		partial[static_cast<size_t>(i)] = sumRow(m.ptr<float>(i), m.cols);
+	}
+	return pairwise(partial);
+}
+
+double Reduction::mean(const cv::Mat& m)
+{
+	return sum(m) / (static_cast<double>(m.rows)*m.cols);
+}
@@ -0,0 +1,308 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "ResultWriter.hpp"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif /* _WIN32 */
+
+// Suffixes of the output files
+static const char *METRIC_SUFFIX[METRIC_SIZE] = {"psnr", "ssim", "msssim", "vifp", "psnrhvs", "psnrhvsm", "ewpsnr"};
+
+// Write the buffered data of a file to disk
+static void syncFile(FILE *f)
+{
+	fflush(f);
+#ifdef _WIN32
+	_commit(_fileno(f));
+#else
+	fsync(fileno(f));
+#endif /* _WIN32 */
+}
+
+bool Checkpoint::load(const std::string& path)
+{
+	frame = -1;
+	std::ifstream in(path.c_str());
+	if (!in) {
+		return true;
+	}
+
+	// One line per field, then for each metric one line with its index, the
+	// offset, sum and compensation (in hexadecimal, to be exact), and one
+	// line with its pooled statistics
+	for (int m=0; m<METRIC_SIZE; m++) {
+		offset[m] = 0;
+		sum[m] = 0.0;
+		compensation[m] = 0.0;
+		stats[m].clear();
+	}
+	std::string line;
+	bool ok = std::getline(in, line) && line.compare(0, 4, "job ") == 0;
+	if (ok) {
+		job = line.substr(4);
+		ok = std::getline(in, line) && sscanf(line.c_str(), "frame %d", &frame) == 1 && frame >= 0;
+	}
+	while (ok && std::getline(in, line)) {
+		int m = -1;
+		int pos = 0;
+		long off;
+		double s, c;
+		if (sscanf(line.c_str(), "stats %d %n", &m, &pos) == 1 && m >= 0 && m < METRIC_SIZE) {
+			stats[m] = line.substr(static_cast<size_t>(pos));
+		}
+		else if (sscanf(line.c_str(), "%d %ld %la %la", &m, &off, &s, &c) == 4 && m >= 0 && m < METRIC_SIZE) {
+			offset[m] = off;
+			sum[m] = s;
+			compensation[m] = c;
+		}
+		else {
+			ok = false;
+		}
+	}
+	if (!ok) {
+		frame = -1;
+		fprintf(stderr, "Invalid checkpoint %s\n", path.c_str());
+	}
+	return ok;
+}
+
+ResultWriter::ResultWriter(const char *p, const bool sel[METRIC_SIZE], bool e, const Checkpoint *resume)
+{
+	prefix = p;
+	echo = e;
+	stream = NULL;
+	summary = false;
+	checkpoint_interval = 0;
+	checkpoint_frames = 0;
+	opened = true;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		result_file[m] = NULL;
+		selected[m] = sel[m];
+	}
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (!selected[m]) continue;
+
+		std::string name = prefix + "_" + METRIC_SUFFIX[m] + ".csv";
+		result_file[m] = fopen(name.c_str(), resume != NULL ? "r+" : "w");
+		if (result_file[m] == NULL) {
+			fprintf(stderr, "Cannot open output file %s\n", name.c_str());
+			opened = false;
+			return;
+		}
+
+		if (resume != NULL) {
+			// Drop the results written after the checkpoint
+			fflush(result_file[m]);
+#ifdef _WIN32
+			int failed = _chsize_s(_fileno(result_file[m]), resume->offset[m]);
+#else
+			int failed = ftruncate(fileno(result_file[m]), resume->offset[m]);
+#endif /* _WIN32 */
+			if (failed || fseek(result_file[m], 0, SEEK_END) != 0 || ftell(result_file[m]) != resume->offset[m]) {
+				fprintf(stderr, "Cannot resume output file %s\n", name.c_str());
+				opened = false;
+				return;
+			}
+			result_avg[m] = CompensatedSum(resume->sum[m], resume->compensation[m]);
+			if (!result_stats[m].load(resume->stats[m])) {
+				fprintf(stderr, "Cannot resume the statistics of %s\n", name.c_str());
+				opened = false;
+				return;
+			}
+		}
+		else {
+			// Print header to file
+			fprintf(result_file[m], "frame,value\n");
+		}
+	}
+}
+
+ResultWriter::ResultWriter(FILE *s, const bool sel[METRIC_SIZE])
+{
+	echo = false;
+	stream = s;
+	summary = false;
+	checkpoint_interval = 0;
+	checkpoint_frames = 0;
+	opened = true;
+	for (int m=0; m<METRIC_SIZE; m++) {
+		result_file[m] = NULL;
+		selected[m] = sel[m];
+	}
+}
+
+ResultWriter::~ResultWriter()
+{
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (result_file[m] != NULL) {
+			fclose(result_file[m]);
+		}
+	}
+}
+
+bool ResultWriter::isOpen() const
+{
+	return opened;
+}
+
+void ResultWriter::write(int frame, const float result[METRIC_SIZE], const bool *computed)
+{
+	if (stream != NULL) {
+		fprintf(stream, "frame %d", frame);
+		for (int m=0; m<METRIC_SIZE; m++) {
+			if (selected[m]) fprintf(stream, " %.9g", static_cast<double>(result[m]));
+		}
+		fprintf(stream, "\n");
+		fflush(stream);
+		return;
+	}
+
+	// Print quality index to file
+	if (echo) std::cout << "Computing: No." << frame << ". result: ";
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (result_file[m] != NULL && computed != NULL && !computed[m]) {
+			if (echo) std::cout << "-  ";
+		}
+		else if (result_file[m] != NULL && std::isnan(result[m])) {
+			// No score (e.g. a frame without weight), out of the average
+			fprintf(result_file[m], "%d,nan\n", frame);
+			if (echo) std::cout << "nan  ";
+		}
+		else if (result_file[m] != NULL) {
+			result_avg[m].add(static_cast<double>(result[m]));
+			result_stats[m].add(static_cast<double>(result[m]));
+			fprintf(result_file[m], "%d,%.6f\n", frame, static_cast<double>(result[m]));
+			if (echo) std::cout << result[m] << "  ";
+		}
+	}
+	if (echo) std::cout << std::endl;
+
+	// Counted in frames written, as frames may be skipped (see FrameAligner)
+	if (checkpoint_interval > 0 && ++checkpoint_frames >= checkpoint_interval) {
+		saveCheckpoint(frame+1);
+		checkpoint_frames = 0;
+	}
+}
+
+void ResultWriter::setSummary(bool enable)
+{
+	summary = enable;
+}
+
+void ResultWriter::mergeStats(PooledStats stats[METRIC_SIZE]) const
+{
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (selected[m]) stats[m].merge(result_stats[m]);
+	}
+}
+
+void ResultWriter::writeSummary(const std::string& path, const PooledStats stats[METRIC_SIZE], const bool selected[METRIC_SIZE])
+{
+	FILE *f = fopen(path.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "Cannot open output file %s\n", path.c_str());
+		return;
+	}
+	fprintf(f, "metric,frames,mean,harmonic_mean,min,p1,p5,p50,max\n");
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (!selected[m]) continue;
+		const PooledStats& st = stats[m];
+		fprintf(f, "%s,%lld,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", METRIC_SUFFIX[m], st.count(), st.mean(), st.harmonicMean(),
+				st.min(), st.quantile(0.01), st.quantile(0.05), st.quantile(0.5), st.max());
+	}
+	fclose(f);
+}
+
+void ResultWriter::setCheckpoint(const std::string& path, int interval, const std::string& job)
+{
+	checkpoint_path = path;
+	checkpoint_interval = interval;
+	checkpoint_frames = 0;
+	checkpoint_job = job;
+}
+
+void ResultWriter::saveCheckpoint(int frame)
+{
+	// The results have to be on disk before the checkpoint refers to them
+	std::string tmp = checkpoint_path + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "w");
+	if (f == NULL) {
+		fprintf(stderr, "Cannot write checkpoint %s\n", tmp.c_str());
+		return;
+	}
+	fprintf(f, "job %s\nframe %d\n", checkpoint_job.c_str(), frame);
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (result_file[m] != NULL) {
+			syncFile(result_file[m]);
+			fprintf(f, "%d %ld %a %a\n", m, ftell(result_file[m]), result_avg[m].getSum(), result_avg[m].getCompensation());
+			fprintf(f, "stats %d %s\n", m, result_stats[m].save().c_str());
+		}
+	}
+	syncFile(f);
+	fclose(f);
+	// Replace the previous checkpoint atomically
+#ifdef _WIN32
+	remove(checkpoint_path.c_str());
+#endif /* _WIN32 */
+	if (rename(tmp.c_str(), checkpoint_path.c_str()) != 0) {
+		fprintf(stderr, "Cannot write checkpoint %s\n", checkpoint_path.c_str());
+	}
+}
+
+void ResultWriter::close()
+{
+	// Print average quality index to file, over the frames of each metric
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (result_file[m] != NULL) {
+			if (result_stats[m].count() > 0) {
+				double avg = result_avg[m].value() / static_cast<double>(result_stats[m].count());
+				fprintf(result_file[m], "average,%.6f", avg);
+			}
+			else {
+				fprintf(result_file[m], "average,nan");
+			}
+			fclose(result_file[m]);
+			result_file[m] = NULL;
+		}
+	}
+
+	if (summary) {
+		writeSummary(prefix + "_summary.csv", result_stats, selected);
+	}
+
+	// The run is complete
+	if (!checkpoint_path.empty()) {
+		remove(checkpoint_path.c_str());
+	}
+}
@@ -33,82 +33,194 @@
 //   Transactions on Image Processing, vol. 13, no. 4, pp. 600–612, April 2004.
 //
 
+#include <algorithm>
+#include <limits>
 #include "SSIM.hpp"
+#include "AlignedMat.hpp"
+#include "GaussianFilter.hpp"
+#include "Kernels.hpp"
+#include "Reduction.hpp"
+#include "ThreadPool.hpp"
 
 const float SSIM::C1 = 6.5025f;
 const float SSIM::C2 = 58.5225f;
 
 SSIM::SSIM(int h, int w) : Metric(h, w)
 {
+	map_enabled = false;
 }
 
 float SSIM::compute(const cv::Mat& original, const cv::Mat& processed)
 {
-	cv::Scalar res = computeSSIM(original, processed);
+	cv::Scalar res = pixel_weights.empty() ? computeSSIM(original, processed, false, true) : computeWeightedSSIM(original, processed, false, pixel_weights, weight_bounds);
 	return float(res.val[0]);
 }
 
-cv::Scalar SSIM::computeSSIM(const cv::Mat& img1, const cv::Mat& img2)
+float SSIM::computeFixed(const cv::Mat& original, const cv::Mat& processed)
 {
+	cv::Scalar res = pixel_weights.empty() ? computeSSIM(original, processed, true, true) : computeWeightedSSIM(original, processed, true, pixel_weights, weight_bounds);
+	return float(res.val[0]);
+}
 
-	int ht = img1.rows;
-	int wt = img1.cols;
-	int w = wt - 10;
-	int h = ht - 10;
-
-	cv::Mat mu1(h,w,CV_32F), mu2(h,w,CV_32F);
-	cv::Mat mu1_sq(h,w,CV_32F), mu2_sq(h,w,CV_32F), mu1_mu2(h,w,CV_32F);
-	cv::Mat img1_sq(ht,wt,CV_32F), img2_sq(ht,wt,CV_32F), img1_img2(ht,wt,CV_32F);
-	cv::Mat sigma1_sq(h,w,CV_32F), sigma2_sq(h,w,CV_32F), sigma12(h,w,CV_32F);
-	cv::Mat tmp1(h,w,CV_32F), tmp2(h,w,CV_32F), tmp3(h,w,CV_32F);
-	cv::Mat ssim_map(h,w,CV_32F), cs_map(h,w,CV_32F);
-
-	// mu1 = filter2(window, img1, 'valid');
-	applyGaussianBlur(img1, mu1, 11, 1.5);
-
-	// mu2 = filter2(window, img2, 'valid');
-	applyGaussianBlur(img2, mu2, 11, 1.5);
+cv::Scalar SSIM::computeSSIM(const cv::Mat& img1, const cv::Mat& img2, bool fixed, bool outputs)
+{
+	int w = img1.cols - 10;
+	int h = img1.rows - 10;
+	bool blocks = outputs && block_size > 0;
+	bool map = outputs && map_enabled;
+
+	// Row sums of the SSIM and contrast maps, filled by independent row bands
+	std::vector<double> ssim_rows(static_cast<size_t>(h)), cs_rows(static_cast<size_t>(h));
+	if (blocks) {
+		block_row_sums.assign(static_cast<size_t>(h*block_cols), 0.0);
+	}
+	if (map) {
+		ssim_map.create(h, w, CV_32F);
+	}
+	ThreadPool::instance().parallelFor(h, bandHeight(h), [&](int begin, int end) {
+		computeSSIMBand(img1, img2, fixed, begin, end, ssim_rows.data(), cs_rows.data(), blocks ? block_row_sums.data() : NULL, map ? &ssim_map : NULL);
+	});
+
+	if (blocks) {
+		// Row i of the map is centred on row i+5 of the image
+		block_sums.assign(static_cast<size_t>(block_rows*block_cols), 0.0);
+		for (int i=0; i<h; i++) {
+			double *dst = &block_sums[static_cast<size_t>(((i+5)/block_size)*block_cols)];
+			const double *src = &block_row_sums[static_cast<size_t>(i*block_cols)];
+			for (int b=0; b<block_cols; b++) {
+				dst[b] += src[b];
+			}
+		}
+	}
+
+	double npixels = static_cast<double>(h)*w;
+	// mssim = mean2(ssim_map);
+	double mssim = Reduction::pairwise(ssim_rows) / npixels;
+	// mcs = mean2(cs_map);
+	double mcs = Reduction::pairwise(cs_rows) / npixels;
 
-	// mu1_sq = mu1.*mu1;
-	cv::multiply(mu1, mu1, mu1_sq);
-	// mu2_sq = mu2.*mu2;
-	cv::multiply(mu2, mu2, mu2_sq);
-	// mu1_mu2 = mu1.*mu2;
-	cv::multiply(mu1, mu2, mu1_mu2);
+	cv::Scalar res(mssim, mcs);
 
-	cv::multiply(img1, img1, img1_sq);
-	cv::multiply(img2, img2, img2_sq);
-	cv::multiply(img1, img2, img1_img2);
+	return res;
+}
 
-	// sigma1_sq = filter2(window, img1.*img1, 'valid') - mu1_sq;
-	applyGaussianBlur(img1_sq, sigma1_sq, 11, 1.5);
-	sigma1_sq -= mu1_sq;
+cv::Scalar SSIM::computeWeightedSSIM(const cv::Mat& img1, const cv::Mat& img2, bool fixed, const cv::Mat& weights, const cv::Rect& bounds)
+{
+	// Windows centred in bounds, element (i, j) of the maps being centred on
+	// pixel (i+5, j+5)
+	cv::Rect windows = cv::Rect(bounds.x-5, bounds.y-5, bounds.width, bounds.height) & cv::Rect(0, 0, img1.cols-10, img1.rows-10);
+	int w = windows.width;
+	int h = windows.height;
+	if (windows.area() > 0) {
+		const KernelTable& kernels = Kernels::get();
+		cv::Mat crop1 = img1(cv::Rect(windows.x, windows.y, w+10, h+10));
+		cv::Mat crop2 = img2(cv::Rect(windows.x, windows.y, w+10, h+10));
+		cv::Mat centres = weights(cv::Rect(windows.x+5, windows.y+5, w, h));
+
+		std::vector<double> weight_rows(static_cast<size_t>(h));
+		for (int i=0; i<h; i++) {
+			weight_rows[static_cast<size_t>(i)] = kernels.sumRow(centres.ptr<float>(i), w);
+		}
+		double total = Reduction::pairwise(weight_rows);
+		if (total > 0.0) {
+			std::vector<double> ssim_rows(static_cast<size_t>(h), 0.0), cs_rows(static_cast<size_t>(h), 0.0);
+			ThreadPool::instance().parallelFor(h, bandHeight(h), [&](int begin, int end) {
+				// Bands without weight are not filtered at all
+				bool empty = true;
+				for (int i=begin; i<end && empty; i++) {
+					empty = !(weight_rows[static_cast<size_t>(i)] > 0.0);
+				}
+				if (!empty) {
+					computeSSIMBand(crop1, crop2, fixed, begin, end, ssim_rows.data(), cs_rows.data(), NULL, NULL, &centres);
+				}
+			});
+			return cv::Scalar(Reduction::pairwise(ssim_rows) / total, Reduction::pairwise(cs_rows) / total);
+		}
+	}
+	// No window has weight: no score
+	double nan = std::numeric_limits<double>::quiet_NaN();
+	return cv::Scalar(nan, nan);
+}
 
-	// sigma2_sq = filter2(window, img2.*img2, 'valid') - mu2_sq;
-	applyGaussianBlur(img2_sq, sigma2_sq, 11, 1.5);
-	sigma2_sq -= mu2_sq;
+void SSIM::computeSSIMBand(const cv::Mat& full1, const cv::Mat& full2, bool fixed, int begin, int end, double *ssim_rows, double *cs_rows, double *row_blocks, cv::Mat *map, const cv::Mat *weights)
+{
+	// Input rows covered by the 11x11 window for the output rows [begin, end)
+	cv::Mat img1 = full1.rowRange(begin, end+10);
+	cv::Mat img2 = full2.rowRange(begin, end+10);
 
-	// sigma12 = filter2(window, img1.*img2, 'valid') - mu1_mu2;
-	applyGaussianBlur(img1_img2, sigma12, 11, 1.5);
-	sigma12 -= mu1_mu2;
+	int ht = img1.rows;
+	int wt = img1.cols;
+	int w = wt - 10;
+	int h = ht - 10;
 
+	const KernelTable& kernels = Kernels::get();
+
+	// Scratch matrices of the thread, one id per matrix
+	cv::Mat mu1 = AlignedMat::scratch(0, h, w, CV_32F), mu2 = AlignedMat::scratch(1, h, w, CV_32F);
+	cv::Mat e11 = AlignedMat::scratch(2, h, w, CV_32F), e22 = AlignedMat::scratch(3, h, w, CV_32F), e12 = AlignedMat::scratch(4, h, w, CV_32F);
+
+	if (fixed) {
+		// All five filter2 at once on the 8-bit images
+		GaussianFilter::get(11, 1.5).applyMomentsFixed(img1, img2, mu1, mu2, e11, e22, e12);
+	}
+	else {
+		cv::Mat img1_sq = AlignedMat::scratch(5, ht, wt, CV_32F), img2_sq = AlignedMat::scratch(6, ht, wt, CV_32F), img1_img2 = AlignedMat::scratch(7, ht, wt, CV_32F);
+
+		// mu1 = filter2(window, img1, 'valid');
+		applyGaussianBlur(img1, mu1, 11, 1.5);
+
+		// mu2 = filter2(window, img2, 'valid');
+		applyGaussianBlur(img2, mu2, 11, 1.5);
+
+		// img1.*img1, img2.*img2, img1.*img2
+		for (int i=0; i<ht; i++) {
+			if (img1.depth() == CV_8U) {
+				kernels.moments8u(img1.ptr<uchar>(i), img2.ptr<uchar>(i), img1_sq.ptr<float>(i), img2_sq.ptr<float>(i), img1_img2.ptr<float>(i), wt);
+			}
+			else {
+				kernels.moments(img1.ptr<float>(i), img2.ptr<float>(i), img1_sq.ptr<float>(i), img2_sq.ptr<float>(i), img1_img2.ptr<float>(i), wt);
+			}
+		}
+
+		// filter2(window, img1.*img1, 'valid')
+		applyGaussianBlur(img1_sq, e11, 11, 1.5);
+		// filter2(window, img2.*img2, 'valid')
+		applyGaussianBlur(img2_sq, e22, 11, 1.5);
+		// filter2(window, img1.*img2, 'valid')
+		applyGaussianBlur(img1_img2, e12, 11, 1.5);
+	}
+
+	// sigma1_sq = filter2(window, img1.*img1, 'valid') - mu1.*mu1;
+	// sigma2_sq = filter2(window, img2.*img2, 'valid') - mu2.*mu2;
+	// sigma12 = filter2(window, img1.*img2, 'valid') - mu1.*mu2;
 	// cs_map = (2*sigma12 + C2)./(sigma1_sq + sigma2_sq + C2);
-	tmp1 = 2*sigma12 + C2;
-	tmp2 = sigma1_sq + sigma2_sq + C2;
-	cv::divide(tmp1, tmp2, cs_map);
 	// ssim_map = ((2*mu1_mu2 + C1).*(2*sigma12 + C2))./((mu1_sq + mu2_sq + C1).*(sigma1_sq + sigma2_sq + C2));
-	tmp3 = 2*mu1_mu2 + C1;
-	cv::multiply(tmp1, tmp3, tmp1);
-	tmp3 = mu1_sq + mu2_sq + C1;
-	cv::multiply(tmp2, tmp3, tmp2);
-	cv::divide(tmp1, tmp2, ssim_map);
+	for (int i=0; i<h; i++) {
+		if (weights) {
+			kernels.ssimRowWeighted(mu1.ptr<float>(i), mu2.ptr<float>(i), e11.ptr<float>(i), e22.ptr<float>(i), e12.ptr<float>(i), C1, C2, weights->ptr<float>(begin+i), w, &ssim_rows[begin+i], &cs_rows[begin+i]);
+		}
+		else if (row_blocks || map) {
+			// Column j of the map is centred on column j+5 of the image
+			kernels.ssimRowMap(mu1.ptr<float>(i), mu2.ptr<float>(i), e11.ptr<float>(i), e22.ptr<float>(i), e12.ptr<float>(i), C1, C2, w, 5, block_size, &ssim_rows[begin+i], &cs_rows[begin+i],
+					row_blocks ? &row_blocks[(begin+i)*block_cols] : NULL, map ? map->ptr<float>(begin+i) : NULL);
+		}
+		else {
+			kernels.ssimRow(mu1.ptr<float>(i), mu2.ptr<float>(i), e11.ptr<float>(i), e22.ptr<float>(i), e12.ptr<float>(i), C1, C2, w, &ssim_rows[begin+i], &cs_rows[begin+i]);
+		}
+	}
+}
 
-	// mssim = mean2(ssim_map);
-	double mssim = cv::mean(ssim_map).val[0];
-	// mcs = mean2(cs_map);
-	double mcs = cv::mean(cs_map).val[0];
+void SSIM::setMapEnabled(bool enable)
+{
+	map_enabled = enable;
+}
 
-	cv::Scalar res(mssim, mcs);
+cv::Mat SSIM::getMap() const
+{
+	return ssim_map;
+}
 
-	return res;
+void SSIM::getBlockSums(double *sums) const
+{
+	std::copy(block_sums.begin(), block_sums.end(), sums);
 }
@@ -0,0 +1,407 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <opencv2/core/core.hpp>
+#include "Server.hpp"
+#include "ResultWriter.hpp"
+#include "VideoYUV.hpp"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Address of the socket at path, exit if the path is too long
+static struct sockaddr_un socketAddress(const char *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, path);
+	return addr;
+}
+
+Server::Server(const char *p, int ct, const int d[STAGE_SIZE-1], PerfCounters *const *pc)
+{
+	path = p;
+	compute_threads = ct > 0 ? ct : 1;
+	for (int s=0; s<STAGE_SIZE-1; s++) {
+		depth[s] = d[s];
+	}
+	perf = pc;
+
+	// Clients that disconnect must not terminate the server
+	signal(SIGPIPE, SIG_IGN);
+
+	struct sockaddr_un addr = socketAddress(p);
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0) {
+		fprintf(stderr, "Cannot create socket: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	// Remove the socket left by a server that did not exit cleanly, unless
+	// a server is still listening on it
+	if (connect(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+		fprintf(stderr, "A server is already listening on %s\n", p);
+		exit(EXIT_FAILURE);
+	}
+	close(listen_fd);
+	unlink(p);
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+		fprintf(stderr, "Cannot listen on %s: %s\n", p, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+Server::~Server()
+{
+	close(listen_fd);
+	unlink(path.c_str());
+	for (std::list<std::pair<std::string, MetricSet*> >::iterator it=idle.begin(); it!=idle.end(); ++it) {
+		delete it->second;
+	}
+}
+
+void Server::run()
+{
+	printf("Listening on %s\n", path.c_str());
+	fflush(stdout);
+	for (;;) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED) continue;
+			fprintf(stderr, "Cannot accept connection: %s\n", strerror(errno));
+			return;
+		}
+		std::thread(&Server::serve, this, fd).detach();
+	}
+}
+
+void Server::serve(int fd)
+{
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(dup(fd), "w");
+	if (in == NULL || out == NULL) {
+		if (in != NULL) fclose(in);
+		else close(fd);
+		if (out != NULL) fclose(out);
+		return;
+	}
+
+	char *line = NULL;
+	size_t capacity = 0;
+	while (getline(&line, &capacity, in) > 0) {
+		double duration = static_cast<double>(cv::getTickCount());
+		std::vector<std::string> args;
+		Job job;
+		std::string error;
+		bool ok = Job::split(line, args) && job.parse(args);
+		if (!ok) {
+			error = "invalid job";
+		}
+		else if (!job.options.empty()) {
+			error = "option " + job.options[0] + " applies to the whole server";
+			ok = false;
+		}
+		else if (job.checkpoint > 0 || job.resume) {
+			// The results are written by the client
+			error = "checkpoints are not supported by the server";
+			ok = false;
+		}
+		else if (job.sample > 0.0 || job.live > 0.0) {
+			// The frames of a job are all read in order and computed in full
+			error = "sampling and live mode are not supported by the server";
+			ok = false;
+		}
+		else if (!job.blocks.empty() || job.maps > 0) {
+			// The grids and maps would be written by the server, not streamed to the client
+			error = "grids of blocks and maps are not supported by the server";
+			ok = false;
+		}
+		else if (!job.roi_mask.empty() || !job.roi_rects.empty()) {
+			// The masks would be read from the server's working directory
+			error = "weight masks are not supported by the server";
+			ok = false;
+		}
+		else if (job.align > 0) {
+			// The whole videos would be read before the first result
+			error = "alignment is not supported by the server";
+			ok = false;
+		}
+		if (ok) {
+			ok = runJob(job, out, error);
+		}
+		if (ok) {
+			fprintf(out, "end\n");
+		}
+		else {
+			fprintf(out, "error %s\n", error.c_str());
+		}
+		fflush(out);
+
+		duration = (static_cast<double>(cv::getTickCount())-duration) / cv::getTickFrequency();
+		printf("%s: %s, %d frames, %0.3fs\n", job.processed.c_str(), ok ? "done" : "failed", job.nbframes, duration);
+		fflush(stdout);
+	}
+	free(line);
+	fclose(in);
+	fclose(out);
+}
+
+bool Server::runJob(const Job& job, FILE *out, std::string& error)
+{
+	// Input videos, from files or shared memory
+	const std::string *names[2] = {&job.original, &job.processed};
+	VideoYUV *video[2] = {NULL, NULL};
+	void *mapped[2] = {NULL, NULL};
+	size_t mapped_size[2] = {0, 0};
+	bool ok = true;
+	for (int v=0; v<2 && ok; v++) {
+		const std::string& name = *names[v];
+		if (name.compare(0, 4, "shm:") == 0) {
+			int shm = shm_open(name.c_str()+4, O_RDONLY, 0);
+			struct stat st;
+			if (shm >= 0 && fstat(shm, &st) == 0 && st.st_size > 0) {
+				mapped_size[v] = static_cast<size_t>(st.st_size);
+				mapped[v] = mmap(NULL, mapped_size[v], PROT_READ, MAP_SHARED, shm, 0);
+			}
+			if (shm >= 0) close(shm);
+			if (mapped[v] == NULL || mapped[v] == MAP_FAILED) {
+				mapped[v] = NULL;
+				error = "cannot map shared memory " + name;
+				ok = false;
+				break;
+			}
+			video[v] = new VideoYUV(static_cast<const imgpel*>(mapped[v]), mapped_size[v], job.height, job.width, job.nbframes, job.chroma, job.stride);
+		}
+		else {
+			// A missing input fails the job only
+			video[v] = new VideoYUV(name.c_str(), job.height, job.width, job.nbframes, job.chroma, job.stride);
+			if (!video[v]->isOpen()) {
+				error = "cannot open input file " + name;
+				ok = false;
+				break;
+			}
+		}
+	}
+
+	if (ok) {
+		ResultWriter *writer = new ResultWriter(out, job.selected);
+		std::vector<MetricSet*> metrics;
+		for (int t=0; t<compute_threads; t++) {
+			metrics.push_back(acquire(job));
+		}
+
+		Pipeline *pipeline = new Pipeline(video[0], video[1], job.nbframes);
+		for (int s=0; s<STAGE_SIZE-1; s++) {
+			if (depth[s] > 0) pipeline->setDepth(s, depth[s]);
+		}
+		ok = pipeline->run(metrics, writer);
+		if (!ok) error = "cannot read all frames";
+
+		delete pipeline;
+		for (size_t t=0; t<metrics.size(); t++) {
+			release(job, metrics[t]);
+		}
+		delete writer;
+	}
+
+	for (int v=0; v<2; v++) {
+		delete video[v];
+		if (mapped[v] != NULL) munmap(mapped[v], mapped_size[v]);
+	}
+	return ok;
+}
+
+// Key of the metric instances that can be used for a job
+static std::string metricsKey(const Job& job)
+{
+	std::string key = std::to_string(job.height) + "x" + std::to_string(job.width) + (job.ssim_fixed ? " fixed" : "");
+	for (int m=0; m<METRIC_SIZE; m++) {
+		if (job.selected[m]) key += std::string(" ") + METRIC_NAME[m];
+	}
+	return key;
+}
+
+MetricSet *Server::acquire(const Job& job)
+{
+	MetricSet *metrics = NULL;
+	{
+		// The most recently used instances first
+		std::lock_guard<std::mutex> guard(idle_lock);
+		std::string key = metricsKey(job);
+		for (std::list<std::pair<std::string, MetricSet*> >::iterator it=idle.end(); it!=idle.begin(); ) {
+			--it;
+			if (it->first == key) {
+				metrics = it->second;
+				idle.erase(it);
+				break;
+			}
+		}
+	}
+	if (metrics == NULL) {
+		return new MetricSet(job.height, job.width, job.selected, job.ssim_fixed, job.original.c_str(), perf);
+	}
+	// The eye-tracking data of EWPSNR depends on the original video
+	metrics->setOriginal(job.original.c_str());
+	return metrics;
+}
+
+void Server::release(const Job& job, MetricSet *metrics)
+{
+	std::vector<MetricSet*> evicted;
+	{
+		std::lock_guard<std::mutex> guard(idle_lock);
+		idle.push_back(std::make_pair(metricsKey(job), metrics));
+		while (idle.size() > static_cast<size_t>(IDLE_JOBS*compute_threads)) {
+			evicted.push_back(idle.front().second);
+			idle.pop_front();
+		}
+	}
+	// Deleted out of the lock, the other connections may go on
+	for (size_t i=0; i<evicted.size(); i++) {
+		delete evicted[i];
+	}
+}
+
+Client::Client(const char *path)
+{
+	signal(SIGPIPE, SIG_IGN);
+	struct sockaddr_un addr = socketAddress(path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+		fprintf(stderr, "Cannot connect to server %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	in = fdopen(dup(fd), "r");
+}
+
+Client::~Client()
+{
+	if (in != NULL) fclose(in);
+	close(fd);
+}
+
+bool Client::run(const Job& job)
+{
+	// Paths are opened by the server, from its own working directory
+	Job remote = job;
+	std::string *names[2] = {&remote.original, &remote.processed};
+	for (int v=0; v<2; v++) {
+		if (names[v]->compare(0, 4, "shm:") == 0) continue;
+		char *absolute = realpath(names[v]->c_str(), NULL);
+		if (absolute != NULL) {
+			*names[v] = absolute;
+			free(absolute);
+		}
+	}
+
+	// Output files as on the command line, named after Output for videos in
+	// shared memory, opened before the job is sent
+	bool shm = job.processed.compare(0, 4, "shm:") == 0;
+	ResultWriter *writer = new ResultWriter(shm ? job.output.c_str() : job.processed.c_str(), job.selected);
+	if (!writer->isOpen()) {
+		delete writer;
+		return false;
+	}
+	writer->setSummary(job.summary);
+
+	std::string request = Job::join(remote.getArguments()) + "\n";
+	size_t sent = 0;
+	while (sent < request.size()) {
+		long n = write(fd, request.data()+sent, request.size()-sent);
+		if (n <= 0) {
+			fprintf(stderr, "Cannot send job to server: %s\n", strerror(errno));
+			delete writer;
+			return false;
+		}
+		sent += static_cast<size_t>(n);
+	}
+
+	float result[METRIC_SIZE] = {0};
+	bool ok = false;
+	char *line = NULL;
+	size_t capacity = 0;
+	while (in != NULL && getline(&line, &capacity, in) > 0) {
+		if (strncmp(line, "frame ", 6) == 0) {
+			char *ptr = line+6;
+			int frame = static_cast<int>(strtol(ptr, &ptr, 10));
+			for (int m=0; m<METRIC_SIZE; m++) {
+				if (job.selected[m]) result[m] = strtof(ptr, &ptr);
+			}
+			writer->write(frame, result);
+		}
+		else if (strcmp(line, "end\n") == 0) {
+			// Print average quality index to file
+			writer->close();
+			ok = true;
+			break;
+		}
+		else {
+			fprintf(stderr, "Server: %s", strncmp(line, "error ", 6) == 0 ? line+6 : line);
+			break;
+		}
+	}
+	if (!ok && (in == NULL || feof(in))) {
+		fprintf(stderr, "Connection to the server lost.\n");
+	}
+	free(line);
+	delete writer;
+	return ok;
+}
+
+#else /* _WIN32 */
+
+Server::Server(const char *, int, const int *, PerfCounters *const *)
+{
+	fprintf(stderr, "The server is not supported on this platform.\n");
+	exit(EXIT_FAILURE);
+}
+
+Server::~Server() {}
+void Server::run() {}
+
+Client::Client(const char *)
+{
+	fprintf(stderr, "The server is not supported on this platform.\n");
+	exit(EXIT_FAILURE);
+}
+
+Client::~Client() {}
+bool Client::run(const Job&) { return false; }
+
+#endif /* _WIN32 */
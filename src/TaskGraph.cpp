@@ -0,0 +1,80 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <thread>
+#include "TaskGraph.hpp"
+
+TaskGraph::TaskGraph(ThreadPool& p) : pool(p), remaining(0)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+	for (size_t i=0; i<nodes.size(); i++) {
+		delete nodes[i];
+	}
+}
+
+int TaskGraph::add(const std::function<void()>& fn, const std::vector<int>& deps)
+{
+	int id = static_cast<int>(nodes.size());
+	Node *node = new Node();
+	node->fn = fn;
+	node->ndeps = static_cast<int>(deps.size());
+	node->pending = 0;
+	nodes.push_back(node);
+	for (size_t i=0; i<deps.size(); i++) {
+		nodes[static_cast<size_t>(deps[i])]->successors.push_back(id);
+	}
+	return id;
+}
+
+void TaskGraph::schedule(int id)
+{
+	pool.submit([this, id]() {
+		Node *node = nodes[static_cast<size_t>(id)];
+		node->fn();
+		for (size_t i=0; i<node->successors.size(); i++) {
+			int next = node->successors[i];
+			if (--nodes[static_cast<size_t>(next)]->pending == 0) schedule(next);
+		}
+		remaining--;
+	});
+}
+
+void TaskGraph::run()
+{
+	remaining = static_cast<int>(nodes.size());
+	for (size_t i=0; i<nodes.size(); i++) {
+		nodes[i]->pending = nodes[i]->ndeps;
+	}
+	for (size_t i=0; i<nodes.size(); i++) {
+		if (nodes[i]->ndeps == 0) schedule(static_cast<int>(i));
+	}
+
+	// Help with pending tasks until the whole graph has completed
+	while (remaining.load() > 0) {
+		if (!pool.runPendingTask()) std::this_thread::yield();
+	}
+}
@@ -0,0 +1,181 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include "ThreadPool.hpp"
+#include "PerfCounters.hpp"
+
+int ThreadPool::requested_threads = 0;
+
+// Index of the queue owned by the calling thread (-1 if not a worker)
+static thread_local int worker_index = -1;
+
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool(requested_threads);
+	return pool;
+}
+
+void ThreadPool::setNumThreads(int n)
+{
+	requested_threads = n;
+}
+
+ThreadPool::ThreadPool(int n) : queued(0), stopping(false)
+{
+	if (n <= 0) {
+		n = static_cast<int>(std::thread::hardware_concurrency());
+	}
+	nthreads = n > 0 ? n : 1;
+
+	// The calling thread participates, hence nthreads-1 workers
+	for (int i=0; i<nthreads; i++) {
+		queues.push_back(new Queue());
+	}
+	for (int i=0; i<nthreads-1; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	for (size_t i=0; i<workers.size(); i++) {
+		workers[i].join();
+	}
+	for (size_t i=0; i<queues.size(); i++) {
+		delete queues[i];
+	}
+}
+
+int ThreadPool::getNumThreads() const
+{
+	return nthreads;
+}
+
+void ThreadPool::submit(const std::function<void()>& task)
+{
+	// Workers push to their own queue, other threads to the injection queue
+	int index = worker_index >= 0 ? worker_index : nthreads-1;
+	{
+		std::lock_guard<std::mutex> guard(queues[static_cast<size_t>(index)]->lock);
+		queues[static_cast<size_t>(index)]->tasks.push_back(task);
+	}
+	queued++;
+	{
+		std::lock_guard<std::mutex> guard(sleep_lock);
+	}
+	wakeup.notify_one();
+}
+
+bool ThreadPool::pop(int index, std::function<void()>& task)
+{
+	Queue *q = queues[static_cast<size_t>(index)];
+	std::lock_guard<std::mutex> guard(q->lock);
+	if (q->tasks.empty()) return false;
+	task = q->tasks.back();
+	q->tasks.pop_back();
+	queued--;
+	return true;
+}
+
+bool ThreadPool::steal(int index, std::function<void()>& task)
+{
+	for (int k=1; k<=nthreads; k++) {
+		Queue *q = queues[static_cast<size_t>((index+k) % nthreads)];
+		std::lock_guard<std::mutex> guard(q->lock);
+		if (!q->tasks.empty()) {
+			task = q->tasks.front();
+			q->tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ThreadPool::runPendingTask()
+{
+	std::function<void()> task;
+	int index = worker_index >= 0 ? worker_index : nthreads-1;
+	if (queued.load() == 0) return false;
+	if (!pop(index, task) && !steal(index, task)) return false;
+	task();
+	return true;
+}
+
+void ThreadPool::workerLoop(int index)
+{
+	worker_index = index;
+	std::function<void()> task;
+	for (;;) {
+		if (pop(index, task) || steal(index, task)) {
+			task();
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sleep_lock);
+		while (queued.load() == 0 && !stopping) {
+			wakeup.wait(guard);
+		}
+		if (stopping) return;
+	}
+}
+
+void ThreadPool::parallelFor(int n, int grain, const std::function<void(int,int)>& body)
+{
+	if (n <= 0) return;
+	if (grain < 1) grain = 1;
+	if (nthreads == 1 || n <= grain) {
+		body(0, n);
+		return;
+	}
+
+	int nchunks = (n + grain - 1) / grain;
+	std::atomic<int> pending(nchunks);
+	// The chunks run by other threads are counted with the scope of the
+	// calling thread, if any (see PerfScope)
+	PerfCounters *counters = PerfScope::current();
+	// The last chunk is run by the calling thread
+	for (int c=0; c<nchunks-1; c++) {
+		int begin = c*grain;
+		int end = begin + grain;
+		submit([&body, &pending, begin, end, counters]() {
+			{
+				PerfScope scope(counters, 0);
+				body(begin, end);
+			}
+			pending--;
+		});
+	}
+	body((nchunks-1)*grain, n);
+	pending--;
+
+	// Help with pending tasks until all chunks have completed
+	while (pending.load() > 0) {
+		if (!runPendingTask()) std::this_thread::yield();
+	}
+}
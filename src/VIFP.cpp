@@ -46,152 +46,126 @@
 //
 
 #include "VIFP.hpp"
+#include "AlignedMat.hpp"
+#include "Kernels.hpp"
+#include "Reduction.hpp"
+#include "ThreadPool.hpp"
 
 const float VIFP::SIGMA_NSQ = 2.0f;
 
-VIFP::VIFP(int h, int w) : Metric(h, w)
+VIFP::VIFP(int h, int w) : Metric(h, w), original_pyramid(PYRAMID_VIFP), processed_pyramid(PYRAMID_VIFP)
 {
+	map_enabled = false;
+}
+
+void VIFP::setMapEnabled(bool enable)
+{
+	map_enabled = enable;
+}
+
+cv::Mat VIFP::getMap() const
+{
+	return vifp_map;
 }
 
 float VIFP::compute(const cv::Mat& original, const cv::Mat& processed)
 {
-	double num = 0.0;
-	double den = 0.0;
-	
-	cv::Mat ref[NLEVS];
-	cv::Mat dist[NLEVS];
-	cv::Mat tmp1, tmp2;
-	
-	int w = width;
-	int h = height;
-	
+	// ref=filter2(win,ref,'valid'); ref=ref(1:2:end,1:2:end);
+	original_pyramid.build(original);
+	// dist=filter2(win,dist,'valid'); dist=dist(1:2:end,1:2:end);
+	processed_pyramid.build(processed);
+
+	return compute(original_pyramid, processed_pyramid);
+}
+
+float VIFP::compute(const Pyramid& original, const Pyramid& processed)
+{
+	double num[NLEVS];
+	double den[NLEVS];
+
 	// for scale=1:4
-	for (int scale=0; scale<NLEVS; scale++) {
-		// N=2^(4-scale+1)+1;
-		int N = (2 << (NLEVS-scale-1)) + 1;
-		
-		if (scale == 0) {
-			original.copyTo(ref[scale]);
-			processed.copyTo(dist[scale]);
+	// The subbands are independent once the pyramid is built
+	ThreadPool::instance().parallelFor(NLEVS, 1, [&](int begin, int end) {
+		for (int scale=begin; scale<end; scale++) {
+			int N = Pyramid::VIFP_WINDOW[scale];
+			computeVIFP(original.getLevel(scale), processed.getLevel(scale), N, num[scale], den[scale], scale == 0 && map_enabled ? &vifp_map : NULL);
 		}
-		else {
-			// ref=filter2(win,ref,'valid');
-			applyGaussianBlur(ref[scale-1], tmp1, N, N/5.0);
-			// dist=filter2(win,dist,'valid');
-			applyGaussianBlur(dist[scale-1], tmp2, N, N/5.0);
-			
-			w = (w-(N-1)) / 2;
-			h = (h-(N-1)) / 2;
-			
-			ref[scale] = cv::Mat(h,w,CV_32F);
-			dist[scale] = cv::Mat(h,w,CV_32F);
-			
-			// ref=ref(1:2:end,1:2:end);
-			cv::resize(tmp1, ref[scale], cv::Size(w,h), 0, 0, cv::INTER_NEAREST);
-			// dist=dist(1:2:end,1:2:end);
-			cv::resize(tmp2, dist[scale], cv::Size(w,h), 0, 0, cv::INTER_NEAREST);
-		}
-		
-		computeVIFP(ref[scale], dist[scale], N, num, den);
+	});
+
+	double num_total = 0.0;
+	double den_total = 0.0;
+	for (int scale=0; scale<NLEVS; scale++) {
+		num_total += num[scale];
+		den_total += den[scale];
 	}
-	
-	return float(num/den);
+
+	return float(num_total/den_total);
 }
 
-void VIFP::computeVIFP(const cv::Mat& ref, const cv::Mat& dist, int N, double& num, double& den)
+void VIFP::computeVIFP(const cv::Mat& ref, const cv::Mat& dist, int N, double& num, double& den, cv::Mat *map)
 {
+	int h = ref.rows - (N-1);
+	if (map) {
+		map->create(h, ref.cols - (N-1), CV_32F);
+	}
+
+	// Row sums of the numerator and denominator maps, filled by independent row bands
+	std::vector<double> num_rows(static_cast<size_t>(h)), den_rows(static_cast<size_t>(h));
+	ThreadPool::instance().parallelFor(h, bandHeight(h), [&](int begin, int end) {
+		computeVIFPBand(ref, dist, N, begin, end, num_rows.data(), den_rows.data(), map);
+	});
+
+	num = Reduction::pairwise(num_rows) / log(10.0);
+	den = Reduction::pairwise(den_rows) / log(10.0);
+}
+
+void VIFP::computeVIFPBand(const cv::Mat& full_ref, const cv::Mat& full_dist, int N, int begin, int end, double *num_rows, double *den_rows, cv::Mat *map)
+{
+	// Input rows covered by the NxN window for the output rows [begin, end)
+	cv::Mat ref = full_ref.rowRange(begin, end+N-1);
+	cv::Mat dist = full_dist.rowRange(begin, end+N-1);
+
 	int w = ref.cols - (N-1);
 	int h = ref.rows - (N-1);
-	
-	cv::Mat tmp(h,w,CV_32F);
-	cv::Mat mu1(h,w,CV_32F), mu2(h,w,CV_32F), mu1_sq(h,w,CV_32F), mu2_sq(h,w,CV_32F), mu1_mu2(h,w,CV_32F), sigma1_sq(h,w,CV_32F), sigma2_sq(h,w,CV_32F), sigma12(h,w,CV_32F), g(h,w,CV_32F), sv_sq(h,w,CV_32F);
-	cv::Mat sigma1_sq_th, sigma2_sq_th, g_th;
-	
+
+	const KernelTable& kernels = Kernels::get();
+
+	// Scratch matrices of the thread, one id per matrix
+	cv::Mat mu1 = AlignedMat::scratch(0, h, w, CV_32F), mu2 = AlignedMat::scratch(1, h, w, CV_32F);
+	cv::Mat ref_sq = AlignedMat::scratch(5, ref.rows, ref.cols, CV_32F), dist_sq = AlignedMat::scratch(6, ref.rows, ref.cols, CV_32F), ref_dist = AlignedMat::scratch(7, ref.rows, ref.cols, CV_32F);
+	cv::Mat e11 = AlignedMat::scratch(2, h, w, CV_32F), e22 = AlignedMat::scratch(3, h, w, CV_32F), e12 = AlignedMat::scratch(4, h, w, CV_32F);
+
 	// mu1 = filter2(win, ref, 'valid');
 	applyGaussianBlur(ref, mu1, N, N/5.0);
 	// mu2 = filter2(win, dist, 'valid');
 	applyGaussianBlur(dist, mu2, N, N/5.0);
-	
-	const float EPSILON = 1e-10f;
-
-	// mu1_sq = mu1.*mu1;
-	cv::multiply(mu1, mu1, mu1_sq);
-	// mu2_sq = mu2.*mu2;
-	cv::multiply(mu2, mu2, mu2_sq);
-	// mu1_mu2 = mu1.*mu2;
-	cv::multiply(mu1, mu2, mu1_mu2);		
-	
-	// sigma1_sq = filter2(win, ref.*ref, 'valid') - mu1_sq;
-	cv::multiply(ref, ref, tmp);
-	applyGaussianBlur(tmp, sigma1_sq, N, N/5.0);
-	sigma1_sq -= mu1_sq;
-	// sigma2_sq = filter2(win, dist.*dist, 'valid') - mu2_sq;
-	cv::multiply(dist, dist, tmp);
-	applyGaussianBlur(tmp, sigma2_sq, N, N/5.0);
-	sigma2_sq -= mu2_sq;
-	// sigma12 = filter2(win, ref.*dist, 'valid') - mu1_mu2;
-	cv::multiply(ref, dist, tmp);
-	applyGaussianBlur(tmp, sigma12, N, N/5.0);
-	sigma12 -= mu1_mu2;
-	
-	// sigma1_sq(sigma1_sq<0)=0;
-	cv::max(sigma1_sq, 0.0f, sigma1_sq);
-	// sigma2_sq(sigma2_sq<0)=0;
-	cv::max(sigma2_sq, 0.0f, sigma2_sq);
-	
-	// g=sigma12./(sigma1_sq+1e-10);
-	tmp = sigma1_sq + EPSILON;
-	cv::divide(sigma12, tmp, g);
-	
-	// sv_sq=sigma2_sq-g.*sigma12;
-	cv::multiply(g, sigma12, tmp);
-	sv_sq = sigma2_sq - tmp;
-	
-	cv::threshold(sigma1_sq, sigma1_sq_th, EPSILON, 1.0f, cv::THRESH_BINARY);
-
-	// g(sigma1_sq<1e-10)=0;
-	cv::multiply(g, sigma1_sq_th, g);
-	
-	// sv_sq(sigma1_sq<1e-10)=sigma2_sq(sigma1_sq<1e-10);
-	cv::multiply(sv_sq, sigma1_sq_th, sv_sq);
-	cv::multiply(sigma2_sq, 1.0f - sigma1_sq_th, tmp);
-	sv_sq += tmp;
-	
-	// sigma1_sq(sigma1_sq<1e-10)=0;
-	cv::threshold(sigma1_sq, sigma1_sq, EPSILON, 1.0f, cv::THRESH_TOZERO);
-	
-	cv::threshold(sigma2_sq, sigma2_sq_th, EPSILON, 1.0f, cv::THRESH_BINARY);
-
-	// g(sigma2_sq<1e-10)=0;
-	cv::multiply(g, sigma2_sq_th, g);
-	
-	// sv_sq(sigma2_sq<1e-10)=0;
-	cv::multiply(sv_sq, sigma2_sq_th, sv_sq);
-	
-	cv::threshold(g, g_th, 0.0f, 1.0f, cv::THRESH_BINARY);
-	
-	// sv_sq(g<0)=sigma2_sq(g<0);
-	cv::multiply(sv_sq, g_th, sv_sq);
-	cv::multiply(sigma2_sq, 1.0f - g_th, tmp);
-	cv::add(sv_sq, tmp, sv_sq);
-	
-	// g(g<0)=0;
-	cv::max(g, 0.0f, g);
-	
-	// sv_sq(sv_sq<=1e-10)=1e-10;
-	cv::max(sv_sq, EPSILON, sv_sq);
-	
+
+	// ref.*ref, dist.*dist, ref.*dist
+	for (int i=0; i<ref.rows; i++) {
+		if (ref.depth() == CV_8U) {
+			kernels.moments8u(ref.ptr<uchar>(i), dist.ptr<uchar>(i), ref_sq.ptr<float>(i), dist_sq.ptr<float>(i), ref_dist.ptr<float>(i), ref.cols);
+		}
+		else {
+			kernels.moments(ref.ptr<float>(i), dist.ptr<float>(i), ref_sq.ptr<float>(i), dist_sq.ptr<float>(i), ref_dist.ptr<float>(i), ref.cols);
+		}
+	}
+
+	// filter2(win, ref.*ref, 'valid')
+	applyGaussianBlur(ref_sq, e11, N, N/5.0);
+	// filter2(win, dist.*dist, 'valid')
+	applyGaussianBlur(dist_sq, e22, N, N/5.0);
+	// filter2(win, ref.*dist, 'valid')
+	applyGaussianBlur(ref_dist, e12, N, N/5.0);
+
 	// num=num+sum(sum(log10(1+g.^2.*sigma1_sq./(sv_sq+sigma_nsq))));
-	sv_sq += SIGMA_NSQ;
-	cv::multiply(g, g, g);
-	cv::multiply(g, sigma1_sq, g);
-	cv::divide(g, sv_sq, tmp);
-	tmp += 1.0f;
-	cv::log(tmp, tmp);
-	num += cv::sum(tmp)[0] / log(10.0f);
-	
 	// den=den+sum(sum(log10(1+sigma1_sq./sigma_nsq)));
-	tmp = 1.0f + sigma1_sq / SIGMA_NSQ;
-	cv::log(tmp, tmp);
-	den += cv::sum(tmp)[0] / log(10.0f);
+	// (natural logarithms, converted to log10 on the totals)
+	for (int i=0; i<h; i++) {
+		if (map) {
+			kernels.vifpRowMap(mu1.ptr<float>(i), mu2.ptr<float>(i), e11.ptr<float>(i), e22.ptr<float>(i), e12.ptr<float>(i), SIGMA_NSQ, w, &num_rows[begin+i], &den_rows[begin+i], map->ptr<float>(begin+i));
+		}
+		else {
+			kernels.vifpRow(mu1.ptr<float>(i), mu2.ptr<float>(i), e11.ptr<float>(i), e22.ptr<float>(i), e12.ptr<float>(i), SIGMA_NSQ, w, &num_rows[begin+i], &den_rows[begin+i]);
+		}
+	}
 }
@@ -22,42 +22,93 @@
 // maintenance, support, updates, enhancements, or modifications.
 //
 
+#include <chrono>
+#include <cstring>
+#include <vector>
 #include "VideoYUV.hpp"
+#include "AlignedMat.hpp"
+#include "Kernels.hpp"
 
-VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format)
+bool VideoYUV::check(int h, int w, int chroma_format, int stride)
+{
+	// Check size
+	bool even_height = chroma_format == FORMAT_NV12 || chroma_format == FORMAT_P010 || chroma_format == CHROMA_SUBSAMP_420;
+	bool even_width = even_height || chroma_format == FORMAT_UYVY || chroma_format == FORMAT_YUYV || chroma_format == CHROMA_SUBSAMP_422;
+	if (even_height && (h % 2 == 1 || w % 2 == 1)) {
+		fprintf(stderr, "%s: 'height' and 'width' have to be even numbers.\n", chroma_format == CHROMA_SUBSAMP_420 ? "YUV420" : "NV12/P010");
+		return false;
+	}
+	if (even_width && w % 2 == 1) {
+		fprintf(stderr, "%s: 'width' has to be an even number.\n", chroma_format == CHROMA_SUBSAMP_422 ? "YUV422" : "UYVY/YUYV");
+		return false;
+	}
+
+	// Check stride against the bytes of a row of luma without padding
+	bool planar = chroma_format < FORMAT_NV12;
+	int row_bytes = (chroma_format == FORMAT_NV12 || planar) ? w : 2*w;
+	if (stride != 0 && stride < row_bytes) {
+		fprintf(stderr, "VideoYUV: 'stride' has to be at least %d bytes.\n", row_bytes);
+		return false;
+	}
+	if (planar && even_width && stride % 2 == 1) {
+		fprintf(stderr, "VideoYUV: 'stride' has to be an even number for subsampled chroma.\n");
+		return false;
+	}
+	return true;
+}
+
+VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format, int stride)
 {
 	file = open(f, O_RDONLY | O_BINARY);
-	if (!file) {
-		fprintf(stderr, "readOneFrame: cannot open input file (%s)\n", f);
+	if (file < 0) {
+		fprintf(stderr, "VideoYUV: cannot open input file (%s)\n", f);
+	}
+	memory = NULL;
+	memory_size = 0;
+	memory_pos = 0;
+	init(h, w, nbf, chroma_format, stride);
+}
+
+VideoYUV::VideoYUV(const imgpel *data, size_t size, int h, int w, int nbf, int chroma_format, int stride)
+{
+	file = -1;
+	memory = data;
+	memory_size = size;
+	memory_pos = 0;
+	init(h, w, nbf, chroma_format, stride);
+}
+
+void VideoYUV::init(int h, int w, int nbf, int chroma_format, int stride)
+{
+	if (!check(h, w, chroma_format, stride)) {
 		exit(EXIT_FAILURE);
 	}
+
 	height = h;
 	width  = w;
 	nbframes = nbf;
+	format = chroma_format;
+	unpack_ns = 0;
 
 	comp_height[0] = h;
 	comp_width [0] = w;
-	if (chroma_format == CHROMA_SUBSAMP_400) {
+	if (chroma_format == FORMAT_NV12 || chroma_format == FORMAT_P010) {
+		comp_height[2] = comp_height[1] = h >> 1;
+		comp_width [2] = comp_width [1] = w >> 1;
+	}
+	else if (chroma_format == FORMAT_UYVY || chroma_format == FORMAT_YUYV) {
+		comp_height[2] = comp_height[1] = h;
+		comp_width [2] = comp_width [1] = w >> 1;
+	}
+	else if (chroma_format == CHROMA_SUBSAMP_400) {
 		comp_height[2] = comp_height[1] = 0;
 		comp_width [2] = comp_width [1] = 0;
 	}
 	else if (chroma_format == CHROMA_SUBSAMP_420) {
-		// Check size
-		if (h % 2 == 1 || w % 2 == 1) {
-			fprintf(stderr, "YUV420: 'height' and 'width' have to be even numbers.\n");
-			exit(EXIT_FAILURE);
-		}
-
 		comp_height[2] = comp_height[1] = h >> 1;
 		comp_width [2] = comp_width [1] = w >> 1;
 	}
 	else if (chroma_format == CHROMA_SUBSAMP_422) {
-		// Check size
-		if (w % 2 == 1) {
-			fprintf(stderr, "YUV422: 'width' has to be an even number.\n");
-			exit(EXIT_FAILURE);
-		}
-
 		comp_height[2] = comp_height[1] = h;
 		comp_width [2] = comp_width [1] = w >> 1;
 	}
@@ -65,50 +116,214 @@ VideoYUV::VideoYUV(const char *f, int h, int w, int nbf, int chroma_format)
 		comp_height[2] = comp_height[1] = h;
 		comp_width [2] = comp_width [1] = w;
 	}
-	comp_size[0] = comp_height[0]*comp_width[0];
-	comp_size[1] = comp_height[1]*comp_width[1];
-	comp_size[2] = comp_height[2]*comp_width[2];
-	
-	size = comp_size[0]+comp_size[1]+comp_size[2];
-	
-	data = new imgpel[size];
-	luma = data;
-	chroma[0] = data+comp_size[0];
-	chroma[1] = data+comp_size[0]+comp_size[1];
+
+	// Bytes of a row of luma without padding
+	bool planar = format < FORMAT_NV12;
+	int row_bytes = (format == FORMAT_NV12 || planar) ? w : 2*w;
+	if (stride == 0) {
+		stride = row_bytes;
+	}
+
+	// Layout of a frame in the file: the chroma of NV12 and P010 share the
+	// rows of one plane, and packed formats have all components in the same rows
+	comp_stride[0] = stride;
+	comp_offset[0] = 0;
+	if (planar) {
+		comp_stride[2] = comp_stride[1] = comp_width[1] == w ? stride : (comp_width[1] > 0 ? stride/2 : 0);
+		comp_offset[1] = h*stride;
+		comp_offset[2] = comp_offset[1] + comp_height[1]*comp_stride[1];
+		frame_size = comp_offset[2] + comp_height[2]*comp_stride[2];
+	}
+	else if (format == FORMAT_NV12 || format == FORMAT_P010) {
+		comp_stride[2] = comp_stride[1] = stride;
+		comp_offset[2] = comp_offset[1] = h*stride;
+		frame_size = comp_offset[1] + comp_height[1]*stride;
+	}
+	else {
+		comp_stride[2] = comp_stride[1] = stride;
+		comp_offset[2] = comp_offset[1] = 0;
+		frame_size = h*stride;
+	}
+
+	if (memory == NULL) {
+		AlignedMat::create(buffer, 1, frame_size, CV_8UC1);
+	}
+	// Components that are not used in place are unpacked into aligned planes
+	for (int c=(planar ? 3 : (format == FORMAT_NV12 ? 1 : 0)); c<3; c++) {
+		AlignedMat::create(plane[c], comp_height[c], comp_width[c], CV_8UC1);
+	}
 }
 
 VideoYUV::~VideoYUV()
 {
-	delete[] data;
-	close(file);
+	if (file >= 0) close(file);
+}
+
+bool VideoYUV::isOpen() const
+{
+	return file >= 0 || memory != NULL;
+}
+
+int VideoYUV::getFrameSize() const
+{
+	return frame_size;
+}
+
+double VideoYUV::getUnpackTime() const
+{
+	return static_cast<double>(unpack_ns)*1e-9;
+}
+
+bool VideoYUV::readBytes(imgpel *buf, int read_size)
+{
+	// Large reads may return fewer bytes than requested
+	int done = 0;
+	while (done < read_size) {
+		long n = read(file, buf+done, static_cast<size_t>(read_size-done));
+		if (n <= 0) {
+			fprintf(stderr, "readOneFrame: cannot read %d bytes from input file, unexpected EOF.\n", read_size-done);
+			return false;
+		}
+		done += static_cast<int>(n);
+	}
+	return true;
+}
+
+bool VideoYUV::seekFrame(int frame)
+{
+	if (memory != NULL) {
+		size_t pos = static_cast<size_t>(frame)*static_cast<size_t>(frame_size);
+		if (pos > memory_size) return false;
+		memory_pos = pos;
+		return true;
+	}
+	off_t offset = static_cast<off_t>(frame)*frame_size;
+	if (lseek(file, offset, SEEK_SET) != offset) {
+		fprintf(stderr, "seekFrame: cannot seek to frame %d.\n", frame);
+		return false;
+	}
+	return true;
 }
 
 bool VideoYUV::readOneFrame()
 {
-	imgpel *ptr_data = data;
-
-	for (int j=0; j<3; j++) {
-		int read_size = comp_width[j];
-		if (read_size <= 0)
-			continue;
-		for (int i=0; i<comp_height[j]; i++) {
-			if (read(file, ptr_data, static_cast<size_t>(read_size)) != read_size) {
-				fprintf(stderr, "readOneFrame: cannot read %d bytes from input file, unexpected EOF.\n", read_size);
-				return false;
-			}
-			ptr_data += read_size;
+	// Frames in memory are used in place
+	if (memory != NULL) {
+		size_t size = static_cast<size_t>(frame_size);
+		if (memory_size - memory_pos < size) {
+			fprintf(stderr, "readOneFrame: cannot read %d bytes from memory, unexpected end.\n", frame_size);
+			return false;
+		}
+		loadFrame(memory + memory_pos);
+		memory_pos += size;
+		return true;
+	}
+
+	// One read per frame, padding included
+	if (!readBytes(buffer.data, frame_size)) return false;
+	loadFrame(buffer.data);
+	return true;
+}
+
+bool VideoYUV::readLumaRow(int frame, int y, imgpel *dst)
+{
+	bool wide = format == FORMAT_P010 || format == FORMAT_UYVY || format == FORMAT_YUYV;
+	int row_bytes = wide ? 2*width : width;
+	size_t offset = static_cast<size_t>(frame)*static_cast<size_t>(frame_size) + static_cast<size_t>(comp_offset[0]) + static_cast<size_t>(y)*static_cast<size_t>(comp_stride[0]);
+	const imgpel *src;
+	if (memory != NULL) {
+		if (offset + static_cast<size_t>(row_bytes) > memory_size) {
+			fprintf(stderr, "readLumaRow: cannot read frame %d from memory, unexpected end.\n", frame);
+			return false;
+		}
+		src = memory + offset;
+	}
+	else {
+		// The row is read into the frame buffer
+		if (lseek(file, static_cast<off_t>(offset), SEEK_SET) != static_cast<off_t>(offset) || !readBytes(buffer.data, row_bytes)) {
+			return false;
 		}
+		src = buffer.data;
+	}
+
+	const KernelTable& kernels = Kernels::get();
+	std::vector<imgpel> u, v;
+	switch (format) {
+		case FORMAT_P010:
+			kernels.narrow16to8u(src, dst, width/2);
+			break;
+		case FORMAT_UYVY:
+		case FORMAT_YUYV:
+			u.resize(static_cast<size_t>(width/2));
+			v.resize(static_cast<size_t>(width/2));
+			if (format == FORMAT_UYVY) {
+				kernels.unpackUYVY(src, dst, u.data(), v.data(), width/2);
+			}
+			else {
+				kernels.unpackYUYV(src, dst, u.data(), v.data(), width/2);
+			}
+			break;
+		default:
+			memcpy(dst, src, static_cast<size_t>(width));
+			break;
 	}
 	return true;
 }
 
+void VideoYUV::loadFrame(const imgpel *src)
+{
+	// Planar samples are used in place, with the stride of the file
+	int nb_planar = format == FORMAT_NV12 || format == CHROMA_SUBSAMP_400 ? 1 : (format < FORMAT_NV12 ? 3 : 0);
+	for (int c=0; c<nb_planar; c++) {
+		plane[c] = cv::Mat(comp_height[c], comp_width[c], CV_8UC1, const_cast<imgpel*>(src+comp_offset[c]), static_cast<size_t>(comp_stride[c]));
+	}
+
+	// The unpacking kernels then write the other planes, row by row
+	if (format < FORMAT_NV12) return;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const KernelTable& kernels = Kernels::get();
+	const imgpel *luma = src+comp_offset[0];
+	const imgpel *chroma = src+comp_offset[1];
+	size_t luma_stride = static_cast<size_t>(comp_stride[0]);
+	size_t chroma_stride = static_cast<size_t>(comp_stride[1]);
+	switch (format) {
+		case FORMAT_NV12:
+			for (int y=0; y<comp_height[1]; y++) {
+				kernels.deinterleave8u(chroma+static_cast<size_t>(y)*chroma_stride, plane[1].ptr<uchar>(y), plane[2].ptr<uchar>(y), comp_width[1]);
+			}
+			break;
+		case FORMAT_P010:
+			for (int y=0; y<height; y++) {
+				kernels.narrow16to8u(luma+static_cast<size_t>(y)*luma_stride, plane[0].ptr<uchar>(y), width/2);
+			}
+			for (int y=0; y<comp_height[1]; y++) {
+				kernels.deinterleave16to8u(chroma+static_cast<size_t>(y)*chroma_stride, plane[1].ptr<uchar>(y), plane[2].ptr<uchar>(y), comp_width[1]);
+			}
+			break;
+		case FORMAT_UYVY:
+			for (int y=0; y<height; y++) {
+				kernels.unpackUYVY(luma+static_cast<size_t>(y)*luma_stride, plane[0].ptr<uchar>(y), plane[1].ptr<uchar>(y), plane[2].ptr<uchar>(y), comp_width[1]);
+			}
+			break;
+		case FORMAT_YUYV:
+			for (int y=0; y<height; y++) {
+				kernels.unpackYUYV(luma+static_cast<size_t>(y)*luma_stride, plane[0].ptr<uchar>(y), plane[1].ptr<uchar>(y), plane[2].ptr<uchar>(y), comp_width[1]);
+			}
+			break;
+		default:
+			break;
+	}
+	unpack_ns += static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
 void VideoYUV::getLuma(cv::Mat& local_luma, int type)
 {
-	cv::Mat tmp(height, width, CV_8UC1, this->luma);
 	if (type == CV_8UC1) {
-		tmp.copyTo(local_luma);
+		// Allocated on the first frame, then reused
+		AlignedMat::create(local_luma, height, width, CV_8UC1);
+		plane[0].copyTo(local_luma);
 	}
 	else {
-		tmp.convertTo(local_luma, type);
+		plane[0].convertTo(local_luma, type);
 	}
 }
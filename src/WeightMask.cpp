@@ -0,0 +1,178 @@
+//
+// Copyright(c) Multimedia Signal Processing Group (MMSPG),
+//              Ecole Polytechnique Fédérale de Lausanne (EPFL)
+//              http://mmspg.epfl.ch
+// All rights reserved.
+// Author: Philippe Hanhart (philippe.hanhart@epfl.ch)
+//
+// Permission is hereby granted, without written agreement and without
+// license or royalty fees, to use, copy, modify, and distribute the
+// software provided and its documentation for research purpose only,
+// provided that this copyright notice and the original authors' names
+// appear on all copies and supporting documentation.
+// The software provided may not be commercially distributed.
+// In no event shall the Ecole Polytechnique Fédérale de Lausanne (EPFL)
+// be liable to any party for direct, indirect, special, incidental, or
+// consequential damages arising out of the use of the software and its
+// documentation.
+// The Ecole Polytechnique Fédérale de Lausanne (EPFL) specifically
+// disclaims any warranties.
+// The software provided hereunder is on an "as is" basis and the Ecole
+// Polytechnique Fédérale de Lausanne (EPFL) has no obligation to provide
+// maintenance, support, updates, enhancements, or modifications.
+//
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "AlignedMat.hpp"
+#include "WeightMask.hpp"
+
+WeightMask::WeightMask(int h, int w)
+{
+	height = h;
+	width = w;
+	video = NULL;
+	video_frames = 0;
+	next_frame = 0;
+}
+
+WeightMask::~WeightMask()
+{
+	delete video;
+}
+
+WeightMask *WeightMask::openVideo(const char *file, int h, int w, int nbframes)
+{
+	// Number of frames from the size of the file (VideoYUV exits if it cannot open it)
+	struct stat st;
+	if (stat(file, &st) != 0) {
+		fprintf(stderr, "Cannot open mask video %s\n", file);
+		return NULL;
+	}
+	long long frame_size = static_cast<long long>(h)*w;
+	long long frames = static_cast<long long>(st.st_size) / frame_size;
+	if (frames != 1 && frames < nbframes) {
+		fprintf(stderr, "Mask video %s has %lld frames of %dx%d samples, 1 or at least %d are required.\n", file, frames, w, h, nbframes);
+		return NULL;
+	}
+
+	WeightMask *mask = new WeightMask(h, w);
+	mask->video = new VideoYUV(file, h, w, static_cast<int>(frames), CHROMA_SUBSAMP_400);
+	mask->video_frames = static_cast<int>(frames);
+	if (!mask->video->isOpen()) {
+		delete mask;
+		return NULL;
+	}
+	return mask;
+}
+
+WeightMask *WeightMask::openRectangles(const char *file, int h, int w)
+{
+	std::ifstream in(file);
+	if (!in) {
+		fprintf(stderr, "Cannot open rectangles %s\n", file);
+		return NULL;
+	}
+
+	WeightMask *mask = new WeightMask(h, w);
+	std::string line;
+	for (int line_no=1; std::getline(in, line); line_no++) {
+		std::istringstream fields(line);
+		std::string frame;
+		if (!(fields >> frame) || frame[0] == '#') continue;
+
+		Region region;
+		char *endptr = NULL;
+		long f = strtol(frame.c_str(), &endptr, 10);
+		bool ok = frame == "*" || (*endptr == '\0' && f >= 0);
+		ok = ok && (fields >> region.rect.x >> region.rect.y >> region.rect.width >> region.rect.height >> region.weight);
+		ok = ok && region.rect.width > 0 && region.rect.height > 0 && region.weight >= 0.0f;
+		std::string extra;
+		if (!ok || fields >> extra) {
+			fprintf(stderr, "%s:%d: invalid rectangle (Frame X Y Width Height Weight).\n", file, line_no);
+			delete mask;
+			return NULL;
+		}
+		region.rect = region.rect & cv::Rect(0, 0, w, h);
+		if (region.rect.area() <= 0) continue;
+		if (frame == "*") {
+			mask->all_regions.push_back(region);
+		}
+		else {
+			mask->frame_regions[static_cast<int>(f)].push_back(region);
+		}
+	}
+	return mask;
+}
+
+bool WeightMask::read(int frame, cv::Mat& weights, cv::Rect& bounds)
+{
+	// Frames without weights of their own
+	bool own = video != NULL ? video_frames > 1 : frame_regions.count(frame) > 0;
+	if (!own && !shared.empty()) {
+		weights = shared;
+		bounds = shared_bounds;
+		return true;
+	}
+
+	// New weights, leaving the shared ones unchanged
+	if (weights.data == shared.data) {
+		weights.release();
+	}
+	AlignedMat::create(weights, height, width, CV_32F);
+	if (video != NULL) {
+		int f = video_frames > 1 ? frame : 0;
+		if (f != next_frame && !video->seekFrame(f)) return false;
+		if (!video->readOneFrame()) return false;
+		next_frame = f+1;
+		video->getLuma(luma, CV_8UC1);
+		luma.convertTo(weights, CV_32F, 1.0/255);
+	}
+	else {
+		std::vector<Region> regions[2] = {all_regions, own ? frame_regions[frame] : std::vector<Region>()};
+		draw(weights, regions, 2);
+	}
+	bounds = nonZeroBounds(weights);
+
+	if (!own) {
+		shared = weights;
+		shared_bounds = bounds;
+	}
+	return true;
+}
+
+void WeightMask::draw(cv::Mat& weights, const std::vector<Region> *regions, int count) const
+{
+	for (int i=0; i<height; i++) {
+		std::fill(weights.ptr<float>(i), weights.ptr<float>(i)+width, 0.0f);
+	}
+	for (int r=0; r<count; r++) {
+		for (size_t k=0; k<regions[r].size(); k++) {
+			const cv::Rect& rect = regions[r][k].rect;
+			for (int i=rect.y; i<rect.y+rect.height; i++) {
+				std::fill(weights.ptr<float>(i)+rect.x, weights.ptr<float>(i)+rect.x+rect.width, regions[r][k].weight);
+			}
+		}
+	}
+}
+
+cv::Rect WeightMask::nonZeroBounds(const cv::Mat& weights)
+{
+	int top = weights.rows, bottom = 0, left = weights.cols, right = 0;
+	for (int i=0; i<weights.rows; i++) {
+		const float *row = weights.ptr<float>(i);
+		int first = 0;
+		while (first < weights.cols && !(row[first] > 0.0f)) first++;
+		if (first == weights.cols) continue;
+		int last = weights.cols;
+		while (!(row[last-1] > 0.0f)) last--;
+		top = std::min(top, i);
+		bottom = i+1;
+		left = std::min(left, first);
+		right = std::max(right, last);
+	}
+	return bottom > top ? cv::Rect(left, top, right-left, bottom-top) : cv::Rect();
+}
@@ -26,13 +26,16 @@
 
  Usage:
   VQMT.exe OriginalVideo ProcessedVideo Height Width NumberOfFrames ChromaFormat Output Metrics
+  VQMT.exe --batch=Manifest Options
+  VQMT.exe --serve=Socket Options
 
-  OriginalVideo: the original video as raw YUV video file, progressively scanned, and 8 bits per sample
-  ProcessedVideo: the processed video as raw YUV video file, progressively scanned, and 8 bits per sample
+  OriginalVideo: the original video as raw YUV video file, progressively scanned, and 8 bits per sample (16 bits for P010)
+  ProcessedVideo: the processed video as raw YUV video file, progressively scanned, and 8 bits per sample (16 bits for P010)
   Height: the height of the video
   Width: the width of the video
   NumberOfFrames: the number of frames to process
-  ChromaFormat: the chroma subsampling format. 0: YUV400, 1: YUV420, 2: YUV422, 3: YUV444
+  ChromaFormat: the chroma subsampling format. 0: YUV400, 1: YUV420, 2: YUV422, 3: YUV444,
+   or the packed and semi-planar formats 4 or NV12, 5 or P010 (rounded to 8 bits), 6 or UYVY, 7 or YUYV
   Output: the name of the output file(s)
   Metrics: the list of metrics to use
    available metrics:
@@ -42,6 +45,55 @@
    - VIFP: Visual Information Fidelity, pixel domain version (VIFp)
    - PSNRHVS: Peak Signal-to-Noise Ratio taking into account Contrast Sensitivity Function (CSF) (PSNR-HVS)
    - PSNRHVSM: Peak Signal-to-Noise Ratio taking into account Contrast Sensitivity Function (CSF) and between-coefficient contrast masking of DCT basis functions (PSNR-HVS-M)
+  Options (may be given anywhere in the list of metrics):
+   - --perf: sample hardware performance counters around each metric (Linux only)
+   - --threads=N: number of threads used within a frame (default: number of cores)
+   - --compute-threads=N: number of frames computed concurrently (default: 1)
+   - --depth=N or --depth=R,C: capacity of the queues between stages (default: 4)
+   - --stats: print queue occupancy and stage utilisation
+   - --stride=N: number of bytes between the starts of two rows of luma in the input files, for
+     rows padded by hardware decoders (chroma rows of YUV420 and YUV422 are padded to N/2 bytes)
+   - --isa=NAME: force the instruction set of the kernels: baseline, sse4.2, avx2 or avx512
+     (default: VQMT_ISA environment variable if set, otherwise the best one supported by the CPU)
+   - --ssim-fixed: compute SSIM in fixed point (faster, differs by less than 2e-4)
+   - --huge-pages: back the frame buffers and scratch matrices with transparent huge pages (Linux only)
+   - --summary: also write the mean, harmonic mean, min, 1st, 5th and 50th percentiles and max of
+     each metric to <output files prefix>_summary.csv
+   - --sample=TOL: compare a stratified random sample of the frames, growing until the 95% confidence
+     interval of the average of each metric is within TOL (e.g. 0.005 for 0.5%) of it
+   - --live=FPS: read the frames at the rate of a live source, compute PSNR for every frame
+     and the other metrics (EWPSNR included) every Nth frame only, N growing while the metrics fall behind the source;
+     the lag of each frame and its metrics are logged in <output files prefix>_live.csv
+   - --deadline=MS: maximum lag of a frame with --live (default: one frame)
+   - --blocks=SIZES: also write PSNR, SSIM, PSNR-HVS and PSNR-HVS-M over the SIZExSIZE blocks of each
+     frame (comma-separated multiples of 8, e.g. 16,64) to <output files prefix>_blocks<SIZE>.bin
+   - --maps=BITS: also write the maps of SSIM and VIFp, quantized to 8 or 16 bits and compressed in the
+     background, to <output files prefix>_ssim_map.bin and <output files prefix>_vifp_map.bin
+   - --roi-mask=FILE: weight the pixels of PSNR, SSIM, MS-SSIM, PSNR-HVS and PSNR-HVS-M by a mask video
+     of 8-bit samples (one plane per frame, or a single one for all frames), the weight being sample/255
+   - --roi-rects=FILE: same as --roi-mask with rectangles, one per line: Frame X Y Width Height Weight
+     (Frame: frame number or * for all frames), the pixels out of all rectangles having no weight
+   - --align=N: detect the original frame matching each processed frame (offset of up to N <= 250 frames,
+     dropped and repeated frames) from luma fingerprints, compare each processed frame with its match
+     (the processed frames without one are skipped) and write the matches to <output files prefix>_align.csv
+   - --checkpoint=N: save a checkpoint every N frames, in <output files prefix>.checkpoint
+   - --resume: continue from the last checkpoint, if any, of the same comparison
+
+ Batch mode:
+  Manifest: a text file with the arguments of one job per line (OriginalVideo ... Metrics, with
+   --stride=N, --ssim-fixed, --summary, --sample=TOL, --live=FPS, --deadline=MS, --blocks=SIZES, --maps=BITS,
+   --roi-mask=FILE, --roi-rects=FILE, --align=N, --checkpoint=N and --resume
+   if needed); empty lines and lines starting
+   with # are ignored. Output is the prefix of the output files of the job. The statistics of the jobs run with
+   --summary are also pooled in <Manifest>_summary.csv
+  Options: the options above, which apply to all jobs, and
+   - --jobs=N: number of jobs run concurrently (default: half the number of threads)
+
+ Server mode (POSIX only):
+  Socket: path of the Unix domain socket on which jobs are accepted, see Server.hpp
+  Options: the options above, which apply to all jobs. Jobs are then run with
+   VQMT.exe --connect=Socket OriginalVideo ProcessedVideo Height Width NumberOfFrames ChromaFormat Output Metrics
+   which writes the same output files as the command line
 
  Example:
   VQMT.exe original.yuv processed.yuv 1088 1920 250 1 results PSNR SSIM MSSSIM VIFP
@@ -54,8 +106,8 @@
  Notes:
  - SSIM comes for free when MSSSIM is computed (but you still need to specify it to get the output)
  - PSNRHVS and PSNRHVSM are always computed at the same time (but you still need to specify both to get the two outputs)
- - When using MSSSIM, the height and width of the video have to be multiple of 16
- - When using VIFP, the height and width of the video have to be multiple of 8
+ - When using MSSSIM, the height and width of the video have to be at least 161
+ - When using VIFP, the height and width of the video have to be at least 41
 
  Changes in version 1.1 (since 1.0) on 30/3/13
  - Added support for large files (>2GB)
@@ -65,226 +117,277 @@
 
 #include <iostream>
 #include <string.h>
+#include <string>
+#include <vector>
 #include <opencv2/core/core.hpp>
+#include "AlignedMat.hpp"
+#include "Batch.hpp"
+#include "FrameSampler.hpp"
+#include "Job.hpp"
+#include "Kernels.hpp"
+#include "LiveScheduler.hpp"
+#include "MetricSet.hpp"
+#include "PerfCounters.hpp"
+#include "Pipeline.hpp"
+#include "ResultWriter.hpp"
+#include "Server.hpp"
+#include "ThreadPool.hpp"
 #include "VideoYUV.hpp"
-#include "PSNR.hpp"
-#include "SSIM.hpp"
-#include "MSSSIM.hpp"
-#include "VIFP.hpp"
-#include "PSNRHVS.hpp"
-#include "EWPSNR.hpp"
-
-
-enum Params {
-	PARAM_ORIGINAL = 1,	// Original video stream (YUV)
-	PARAM_PROCESSED,	// Processed video stream (YUV)
-	PARAM_HEIGHT,		// Height
-	PARAM_WIDTH,		// Width
-	PARAM_NBFRAMES,		// Number of frames
-	PARAM_CHROMA,		// Chroma format
-	PARAM_RESULTS,		// Output file for results
-	PARAM_METRICS,		// Metric(s) to compute
-	PARAM_SIZE
-};
-
-enum Metrics {
-	METRIC_PSNR = 0,
-	METRIC_SSIM,
-	METRIC_MSSSIM,
-	METRIC_VIFP,
-	METRIC_PSNRHVS,
-	METRIC_PSNRHVSM,
-    METRIC_EWPSNR,
-	METRIC_SIZE
-};
 
-int main (int argc, const char *argv[])
+
+// Number of concurrent jobs of a batch by default: half the threads of the
+// pool, so that a job starting or ending does not leave cores idle
+static int defaultJobs()
 {
-	// Check number of input parameters
-	if (argc < PARAM_SIZE) {
-		fprintf(stderr, "Check software usage: at least %d parameters are required.\n", PARAM_SIZE);
-		return EXIT_FAILURE;
-	}
+	int njobs = ThreadPool::instance().getNumThreads()/2;
+	return njobs > 0 ? njobs : 1;
+}
 
+int main (int argc, const char *argv[])
+{
 	double duration = static_cast<double>(cv::getTickCount());
 
-	// Input parameters
-	char *endptr = NULL;
-	int height = static_cast<int>(strtol(argv[PARAM_HEIGHT], &endptr, 10));
-	if (*endptr) {
-		fprintf(stderr, "Incorrect value for video height: %s\n", argv[PARAM_HEIGHT]);
-		return EXIT_FAILURE;
+	// Manifest of a batch of jobs, socket of a server, or input parameters
+	// of a single job
+	const char *manifest = NULL;
+	const char *serve_path = NULL;
+	const char *connect_path = NULL;
+	Job job;
+	std::vector<std::string> options;
+	if (argc > 1 && strncmp(argv[1], "--batch=", 8) == 0) {
+		manifest = argv[1]+8;
+		options.assign(argv+2, argv+argc);
 	}
-	int width = static_cast<int>(strtol(argv[PARAM_WIDTH], &endptr, 10));
-	if (*endptr) {
-		fprintf(stderr, "Incorrect value for video width: %s\n", argv[PARAM_WIDTH]);
-		return EXIT_FAILURE;
-	}
-	int nbframes = static_cast<int>(strtol(argv[PARAM_NBFRAMES], &endptr, 10));
-	if (*endptr) {
-		fprintf(stderr, "Incorrect value for number of frames: %s\n", argv[PARAM_NBFRAMES]);
-		return EXIT_FAILURE;
+	else if (argc > 1 && strncmp(argv[1], "--serve=", 8) == 0) {
+		serve_path = argv[1]+8;
+		options.assign(argv+2, argv+argc);
 	}
-	int chroma = static_cast<int>(strtol(argv[PARAM_CHROMA], &endptr, 10));
-	if (*endptr) {
-		fprintf(stderr, "Incorrect value for chroma: %s\n", argv[PARAM_CHROMA]);
-		return EXIT_FAILURE;
+	else {
+		// The socket of a server may also come first, see below
+		int first = 1;
+		if (argc > 1 && strncmp(argv[1], "--connect=", 10) == 0) {
+			connect_path = argv[1]+10;
+			first = 2;
+		}
+		if (!job.parse(std::vector<std::string>(argv+first, argv+argc))) return EXIT_FAILURE;
+		options = job.options;
 	}
 
-	// Input video streams
-	VideoYUV *original  = new VideoYUV(argv[PARAM_ORIGINAL], height, width, nbframes, chroma);
-	VideoYUV *processed = new VideoYUV(argv[PARAM_PROCESSED], height, width, nbframes, chroma);
-
-
-	// Output files for results
-	FILE *result_file[METRIC_SIZE] = {NULL};
-	char *str = new char[256];
-	for (int i=7; i<argc; i++) {
-		if (strcmp(argv[i], "PSNR") == 0) {
-			sprintf(str, "%s_psnr.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_PSNR] = fopen(str, "w");
+	// Options
+	bool use_perf = false;
+	bool print_stats = false;
+	bool huge_pages = false;
+	int nthreads = 0;
+	int compute_threads = 1;
+	int njobs = 0;
+	int depth[STAGE_SIZE-1] = {0};
+	const char *isa = NULL;
+	for (size_t i=0; i<options.size(); i++) {
+		const char *arg = options[i].c_str();
+		if (strcmp(arg, "--perf") == 0) {
+			use_perf = true;
 		}
-		else if (strcmp(argv[i], "SSIM") == 0) {
-			sprintf(str, "%s_ssim.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_SSIM] = fopen(str, "w");
+		else if (strcmp(arg, "--stats") == 0) {
+			print_stats = true;
 		}
-		else if (strcmp(argv[i], "MSSSIM") == 0) {
-			sprintf(str, "%s_msssim.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_MSSSIM] = fopen(str, "w");
+		else if (strcmp(arg, "--huge-pages") == 0) {
+			huge_pages = true;
 		}
-		else if (strcmp(argv[i], "VIFP") == 0) {
-			sprintf(str, "%s_vifp.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_VIFP] = fopen(str, "w");
+		else if (strncmp(arg, "--threads=", 10) == 0) {
+			nthreads = Job::parseOption(arg, "--threads=");
+			if (nthreads < 0) return EXIT_FAILURE;
 		}
-		else if (strcmp(argv[i], "PSNRHVS") == 0) {
-			sprintf(str, "%s_psnrhvs.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_PSNRHVS] = fopen(str, "w");
+		else if (strncmp(arg, "--compute-threads=", 18) == 0) {
+			compute_threads = Job::parseOption(arg, "--compute-threads=");
+			if (compute_threads < 0) return EXIT_FAILURE;
 		}
-		else if (strcmp(argv[i], "PSNRHVSM") == 0) {
-			sprintf(str, "%s_psnrhvsm.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_PSNRHVSM] = fopen(str, "w");
+		else if (manifest != NULL && strncmp(arg, "--jobs=", 7) == 0) {
+			njobs = Job::parseOption(arg, "--jobs=");
+			if (njobs < 0) return EXIT_FAILURE;
 		}
-		else if (strcmp(argv[i], "EWPSNR") == 0) {
-			sprintf(str, "%s_ewpsnr.csv", argv[PARAM_PROCESSED]);
-			result_file[METRIC_EWPSNR] = fopen(str, "w");
+		else if (manifest == NULL && serve_path == NULL && strncmp(arg, "--connect=", 10) == 0) {
+			connect_path = arg+10;
+		}
+		else if (strncmp(arg, "--isa=", 6) == 0) {
+			isa = arg+6;
+		}
+		else if (strncmp(arg, "--depth=", 8) == 0) {
+			// One depth for all queues, or one per queue separated by commas
+			const char *ptr = arg+8;
+			char *endptr = NULL;
+			for (int s=0; s<STAGE_SIZE-1; s++) {
+				depth[s] = static_cast<int>(strtol(ptr, &endptr, 10));
+				if (*endptr == ',') {
+					ptr = endptr+1;
+				}
+				else if (*endptr == '\0') {
+					for (int t=s+1; t<STAGE_SIZE-1; t++) depth[t] = depth[s];
+					break;
+				}
+				else {
+					fprintf(stderr, "Incorrect value for option --depth=%s\n", arg+8);
+					return EXIT_FAILURE;
+				}
+			}
 		}
-	}
-	delete[] str;
-
-	// Check size for VIFp downsampling
-	if (result_file[METRIC_VIFP] != NULL && (height % 8 != 0 || width % 8 != 0)) {
-		fprintf(stderr, "VIFp: 'height' and 'width' have to be multiple of 8.\n");
-		exit(EXIT_FAILURE);
-	}
-	// Check size for MS-SSIM downsampling
-	if (result_file[METRIC_MSSSIM] != NULL && (height % 16 != 0 || width % 16 != 0)) {
-		fprintf(stderr, "MS-SSIM: 'height' and 'width' have to be multiple of 16.\n");
-		exit(EXIT_FAILURE);
 	}
 
-	// Print header to file
-	for (int m=0; m<METRIC_SIZE; m++) {
-		if (result_file[m] != NULL) {
-			fprintf(result_file[m], "frame,value\n");
-		}
+	// Job run by a server, the other options are those of the server
+	if (connect_path != NULL) {
+		Client *client = new Client(connect_path);
+		bool ok = client->run(job);
+		delete client;
+		duration = static_cast<double>(cv::getTickCount())-duration;
+		duration /= cv::getTickFrequency();
+		printf("Time: %0.3fs\n", duration);
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 
-	PSNR *psnr     = new PSNR(height, width);
-	SSIM *ssim     = new SSIM(height, width);
-	MSSSIM *msssim = new MSSSIM(height, width);
-	VIFP *vifp     = new VIFP(height, width);
-	PSNRHVS *phvs  = new PSNRHVS(height, width);
-    EWPSNR *ewpsnr = new EWPSNR(height, width);
+	// Jobs of the batch, checked before any of them is started
+	Batch *batch = manifest != NULL ? new Batch(manifest) : NULL;
 
-    if (result_file[METRIC_EWPSNR] != NULL) {
-        ewpsnr->match_eye_track_data(argv[PARAM_ORIGINAL]);
-    }
+	// Huge pages for the frame buffers, before any of them is allocated
+	if (huge_pages && !AlignedMat::setHugePages(true)) {
+		fprintf(stderr, "Transparent huge pages are not available, ignoring --huge-pages.\n");
+	}
 
+	// Threads used within a frame (0: one per core)
+	// OpenCV's own threading is disabled to avoid oversubscription
+	ThreadPool::setNumThreads(nthreads);
+	cv::setNumThreads(0);
 
-	cv::Mat original_frame(height,width,CV_32F), processed_frame(height,width,CV_32F);
-	float result[METRIC_SIZE] = {0};
-	float result_avg[METRIC_SIZE] = {0};
+	// Kernels for the instruction set of the CPU
+	Kernels::init(isa);
 
-	for (int frame=0; frame<nbframes; frame++) {
-        std::cout << "Computing: No." << frame;
+	// Hardware performance counters
+	PerfCounters *perf[METRIC_SIZE] = {NULL};
+	if (use_perf) {
+		if (PerfCounters::available()) {
+			for (int m=0; m<METRIC_SIZE; m++) {
+				perf[m] = new PerfCounters(METRIC_NAME[m]);
+			}
+		}
+		else {
+			fprintf(stderr, "Hardware performance counters are not available, ignoring --perf.\n");
+		}
+	}
 
-		// Grab frame
-		if (!original->readOneFrame()) exit(EXIT_FAILURE);
-		original->getLuma(original_frame, CV_32F);
-		if (!processed->readOneFrame()) exit(EXIT_FAILURE);
-		processed->getLuma(processed_frame, CV_32F);
+	// Jobs sent by clients, until the process is terminated
+	if (serve_path != NULL) {
+		Server *server = new Server(serve_path, compute_threads, depth, perf);
+		server->run();
+		delete server;
+		return EXIT_FAILURE;
+	}
 
-		// Compute PSNR
-		if (result_file[METRIC_PSNR] != NULL) {
-			result[METRIC_PSNR] = psnr->compute(original_frame, processed_frame);
+	int status = EXIT_SUCCESS;
+	Pipeline *pipeline = NULL;
+	if (batch != NULL) {
+		int nfailed = batch->run(njobs > 0 ? njobs : defaultJobs(), compute_threads, depth, perf);
+		if (nfailed > 0) status = EXIT_FAILURE;
+		printf("Jobs: %d, failed: %d, frames: %lld\n", batch->size(), nfailed, batch->getFrames());
+		delete batch;
+	}
+	else {
+		// Input video streams
+		VideoYUV *original  = new VideoYUV(job.original.c_str(), job.height, job.width, job.nbframes, job.chroma, job.stride);
+		VideoYUV *processed = new VideoYUV(job.processed.c_str(), job.height, job.width, job.nbframes, job.chroma, job.stride);
+		if (!original->isOpen() || !processed->isOpen()) exit(EXIT_FAILURE);
+
+		// Output files for results, continued from the last checkpoint with --resume
+		int first_frame = 0;
+		ResultWriter *writer = job.createWriter(job.processed, true, first_frame);
+		if (writer == NULL) exit(EXIT_FAILURE);
+		if (first_frame > 0) {
+			if (!original->seekFrame(first_frame) || !processed->seekFrame(first_frame)) exit(EXIT_FAILURE);
+			printf("Resuming at frame %d\n", first_frame);
 		}
 
-        // Compute EWPSNR
-        if (result_file[METRIC_EWPSNR] != NULL) {
-            ewpsnr->set_frame_no(static_cast<unsigned int>(frame));
-            result[METRIC_EWPSNR] = ewpsnr->compute(original_frame, processed_frame);
-        }
+		// One set of metrics per compute thread
+		std::vector<MetricSet*> metrics;
+		for (int t=0; t<(compute_threads > 0 ? compute_threads : 1); t++) {
+			metrics.push_back(new MetricSet(job.height, job.width, job.selected, job.ssim_fixed, job.original.c_str(), perf));
+		}
 
-		// Compute SSIM and MS-SSIM
-		if (result_file[METRIC_SSIM] != NULL && result_file[METRIC_MSSSIM] == NULL) {
-			result[METRIC_SSIM] = ssim->compute(original_frame, processed_frame);
+		pipeline = new Pipeline(original, processed, job.nbframes);
+		for (int s=0; s<STAGE_SIZE-1; s++) {
+			if (depth[s] > 0) pipeline->setDepth(s, depth[s]);
 		}
-		if (result_file[METRIC_MSSSIM] != NULL) {
-			msssim->compute(original_frame, processed_frame);
-			if (result_file[METRIC_SSIM] != NULL) {
-				result[METRIC_SSIM] = msssim->getSSIM();
-			}
-			result[METRIC_MSSSIM] = msssim->getMSSSIM();
+		pipeline->setFirstFrame(first_frame);
+
+		// Sample of the frames with --sample, whose estimates are printed as it grows
+		FrameSampler *sampler = NULL;
+		if (job.sample > 0.0) {
+			sampler = new FrameSampler(job.nbframes, job.selected, job.sample);
+			sampler->setProgress(stdout);
+			pipeline->setSampler(sampler);
 		}
-
-		// Compute VIFp
-		if (result_file[METRIC_VIFP] != NULL) {
-			result[METRIC_VIFP] = vifp->compute(original_frame, processed_frame);
+		// Metrics of each frame of a live source with --live
+		LiveScheduler *scheduler = job.createScheduler(job.processed);
+		if (scheduler != NULL) pipeline->setScheduler(scheduler);
+		// Grids of blocks with --blocks
+		BlockWriter *block_writer = job.createBlockWriter(job.processed);
+		if (block_writer != NULL) pipeline->setBlockWriter(block_writer);
+		// Compressed maps with --maps
+		MapWriter *map_writer = job.createMapWriter(job.processed);
+		if (map_writer != NULL) pipeline->setMapWriter(map_writer);
+		// Weights of the pixels with --roi-mask or --roi-rects
+		WeightMask *weight_mask = NULL;
+		if (!job.createWeightMask(weight_mask)) exit(EXIT_FAILURE);
+		if (weight_mask != NULL) pipeline->setWeightMask(weight_mask);
+		// Matching original frame of each processed frame with --align, saved
+		// to <output files prefix>_align.csv
+		FrameAligner *aligner = job.createAligner();
+		if (aligner != NULL) {
+			if (!aligner->align(original, processed, job.nbframes) || !aligner->save(job.processed + "_align.csv")) exit(EXIT_FAILURE);
+			aligner->report(stdout);
+			pipeline->setAligner(aligner);
 		}
-
-		// Compute PSNR-HVS and PSNR-HVS-M
-		if (result_file[METRIC_PSNRHVS] != NULL || result_file[METRIC_PSNRHVSM] != NULL) {
-			phvs->compute(original_frame, processed_frame);
-			if (result_file[METRIC_PSNRHVS] != NULL) {
-				result[METRIC_PSNRHVS] = phvs->getPSNRHVS();
-			}
-			if (result_file[METRIC_PSNRHVSM] != NULL) {
-				result[METRIC_PSNRHVSM] = phvs->getPSNRHVSM();
-			}
+		if (!pipeline->run(metrics, writer)) exit(EXIT_FAILURE);
+
+		// Print average quality index to file
+		writer->close();
+		if (scheduler != NULL) scheduler->report(stdout);
+		if (map_writer != NULL) {
+			map_writer->close();
+			map_writer->report(stdout);
 		}
-
-		// Print quality index to file
-        std::cout << ". result: ";
-		for (int m=0; m<METRIC_SIZE; m++) {
-			if (result_file[m] != NULL) {
-				result_avg[m] += result[m];
-				fprintf(result_file[m], "%d,%.6f\n", frame, static_cast<double>(result[m]));
-                std::cout << result[m] << "  ";
-			}
+		delete sampler;
+		delete scheduler;
+		delete block_writer;
+		delete map_writer;
+		delete weight_mask;
+		delete aligner;
+
+		for (size_t t=0; t<metrics.size(); t++) {
+			delete metrics[t];
 		}
-        std::cout << std::endl;
+		delete writer;
+		delete original;
+		delete processed;
 	}
 
-	// Print average quality index to file
+	// Print hardware performance counters
 	for (int m=0; m<METRIC_SIZE; m++) {
-		if (result_file[m] != NULL) {
-			result_avg[m] /= static_cast<float>(nbframes);
-			fprintf(result_file[m], "average,%.6f", static_cast<double>(result_avg[m]));
-			fclose(result_file[m]);
+		if (perf[m] != NULL) {
+			perf[m]->report(stdout);
 		}
 	}
-
-	delete psnr;
-	delete ssim;
-	delete msssim;
-	delete vifp;
-	delete phvs;
-	delete original;
-	delete processed;
+	if (print_stats) {
+		printf("Kernels: %s\n", ISA_NAME[Kernels::getISA()]);
+		if (pipeline != NULL) pipeline->report(stdout);
+	}
+	for (int m=0; m<METRIC_SIZE; m++) {
+		delete perf[m];
+	}
 
 	duration = static_cast<double>(cv::getTickCount())-duration;
 	duration /= cv::getTickFrequency();
 	printf("Time: %0.3fs\n", duration);
+	if (pipeline != NULL && job.nbframes > 0) {
+		printf("Frame latency (%d threads): mean %0.3fms, max %0.3fms\n", ThreadPool::instance().getNumThreads(), 1000*pipeline->getMeanLatency(), 1000*pipeline->getMaxLatency());
+	}
+	delete pipeline;
 
-	return EXIT_SUCCESS;
+	return status;
 }